@@ -0,0 +1,78 @@
+#ifndef CURSOR_PREDICTOR_H
+#define CURSOR_PREDICTOR_H
+
+// Guesses where a pointer will be a little into the future from its recent
+// samples, so the balls can react to where the cursor is when the frame is
+// actually on screen rather than where it was when the sample came in.
+// Velocity and acceleration are smoothed from consecutive samples; the
+// extrapolation is damped with the horizon and capped so a flick can't fling
+// the predicted cursor far past where the hand stopped.
+
+#include <cmath>
+#include <cstdint>
+
+class CursorPredictor {
+private:
+    static constexpr double VELOCITY_SMOOTHING = 0.5;
+    static constexpr double ACCELERATION_SMOOTHING = 0.3;
+    static constexpr double DAMPING_US = 50000.0;          // horizon at which the guess is halved
+    static constexpr double MAX_HORIZON_US = 80000.0;      // further than this past the last sample, the cursor stopped
+    static constexpr double STALE_US = 50000.0;            // gap between samples that resets the motion
+    static constexpr double MAX_DISTANCE = 150.0;          // cap on how far ahead the guess can go
+
+    double x, y;
+    double vx, vy; // pixels per microsecond
+    double ax, ay; // pixels per microsecond squared
+    uint64_t lastUs;
+    int samples;
+
+public:
+    CursorPredictor() : x(0), y(0), vx(0), vy(0), ax(0), ay(0), lastUs(0), samples(0) {}
+
+    void addSample(double sx, double sy, uint64_t timeUs) {
+        double dt = samples > 0 ? static_cast<double>(timeUs) - static_cast<double>(lastUs) : 0;
+        if (samples == 0 || dt > STALE_US) {
+            // First sample, or the cursor had stopped: start over
+            vx = vy = ax = ay = 0;
+            samples = 1;
+        } else if (dt > 0) {
+            double nvx = (sx - x) / dt, nvy = (sy - y) / dt;
+            if (samples > 1) {
+                ax += ((nvx - vx) / dt - ax) * ACCELERATION_SMOOTHING;
+                ay += ((nvy - vy) / dt - ay) * ACCELERATION_SMOOTHING;
+                vx += (nvx - vx) * VELOCITY_SMOOTHING;
+                vy += (nvy - vy) * VELOCITY_SMOOTHING;
+            } else {
+                vx = nvx;
+                vy = nvy;
+            }
+            samples++;
+        }
+        // Samples with the same timestamp just replace the position
+        x = sx;
+        y = sy;
+        lastUs = timeUs;
+    }
+
+    // Where the pointer is expected to be at atUs (same clock as the samples).
+    // Returns false when there is nothing sensible to extrapolate.
+    bool predict(uint64_t atUs, double& px, double& py) const {
+        if (samples < 2 || atUs <= lastUs) return false;
+        double h = static_cast<double>(atUs - lastUs);
+        if (h > MAX_HORIZON_US) return false;
+
+        double damping = 1.0 / (1.0 + h / DAMPING_US);
+        double dx = (vx * h + 0.5 * ax * h * h) * damping;
+        double dy = (vy * h + 0.5 * ay * h * h) * damping;
+        double d = std::sqrt(dx * dx + dy * dy);
+        if (d > MAX_DISTANCE) {
+            dx *= MAX_DISTANCE / d;
+            dy *= MAX_DISTANCE / d;
+        }
+        px = x + dx;
+        py = y + dy;
+        return true;
+    }
+};
+
+#endif
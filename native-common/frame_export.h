@@ -0,0 +1,539 @@
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+// Hands rendered frames to other processes on the same machine without
+// copying them. The balls are drawn straight into a ring of memfd buffers,
+// and every consumer maps the same buffers read-only. A small control memfd
+// says which buffer is newest; a seqlock over it keeps the frame number,
+// timestamp and buffer index consistent without the producer ever waiting.
+// Each consumer also gets its own eventfd, bumped once per frame, to poll on.
+//
+// Consumers connect to a Unix socket and get every fd in one message
+// (SCM_RIGHTS): the control memfd, their eventfd, then one memfd per buffer.
+// The same socket carries pointer input back, so a consumer with a screen
+// can push the balls around (FramePointerMessage).
+//
+// A buffer is reused slotCount - 1 frames after it was published. A consumer
+// that holds on to a frame longer than that sees it change under it; it can
+// check with FrameImporter::valid() after using the pixels and drop the
+// frame if it was torn.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "input_queue.h"
+#include "raster.h"
+
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010 // Linux 5.1, older headers don't have it
+#endif
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "the shared header needs address-free atomics");
+
+enum {
+    FRAME_EXPORT_MAGIC = 0x6C6C6162, // "ball"
+    FRAME_EXPORT_VERSION = 1,
+    FRAME_EXPORT_MAX_SLOTS = 8
+};
+
+// Pixels are 32-bit words, 0xFFRRGGBB: B, G, R, A in memory on little-endian
+// machines, which is what OBS calls BGRA. Alpha is always opaque.
+enum { FRAME_FORMAT_XRGB8888 = 1 };
+
+// Per buffer: sequence is odd while the producer draws into it
+struct FrameSlot {
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint64_t> frameNumber;
+    std::atomic<uint64_t> timestampUs;
+};
+
+// The control memfd. The fields before sequence never change after the
+// consumer connects; the ones after it are covered by the seqlock.
+struct FrameRingHeader {
+    uint32_t magic, version;
+    uint32_t width, height;
+    uint32_t stride; // bytes per row
+    uint32_t format;
+    uint32_t slotCount;
+    uint32_t slotBytes;
+
+    std::atomic<uint32_t> sequence;  // odd while the fields below are updated
+    std::atomic<uint32_t> latestSlot;
+    std::atomic<uint64_t> frameNumber; // 0 until the first frame
+    std::atomic<uint64_t> timestampUs; // CLOCK_MONOTONIC, when the frame was finished
+
+    FrameSlot slots[FRAME_EXPORT_MAX_SLOTS];
+};
+
+// Consumer to producer over the socket. pointer is the consumer's own id for
+// a mouse or finger; x, y are in frame pixels.
+struct FramePointerMessage {
+    uint32_t pointer;
+    uint32_t released;
+    float x, y;
+};
+
+struct FrameExportHello {
+    uint32_t magic;
+    uint32_t fdCount; // control, eventfd, then the slots
+};
+
+namespace frame_export {
+
+// A sealed memfd mapped read-write here. Future-write sealing stops anyone
+// else from mapping it writable; older kernels just get the size seals.
+inline void* createShared(const char* name, size_t size, int& fd) {
+    fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        close(fd);
+        fd = -1;
+        return nullptr;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        fd = -1;
+        return nullptr;
+    }
+    const int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+    if (fcntl(fd, F_ADD_SEALS, seals | F_SEAL_FUTURE_WRITE) < 0) fcntl(fd, F_ADD_SEALS, seals);
+    return data;
+}
+
+}
+
+// Producer side. Draw into target(), then publish(); the next target() is
+// always the buffer after the newest one. Everything runs on the caller's
+// thread and never blocks; poll fd() and call dispatch() when it's readable.
+class FrameExporter {
+private:
+    struct Consumer {
+        int socketFd;
+        int eventFd;
+        uint32_t pointerBase;
+        std::vector<uint32_t> pointersDown;
+        FramePointerMessage partial; // a message split across reads
+        size_t partialBytes;
+    };
+
+    int listenFd;
+    int epollFd;
+    std::string unixPath;
+    int headerFd;
+    FrameRingHeader* header;
+    size_t slotBytes;
+    std::vector<int> slotFds;
+    std::vector<uint32_t*> slotPixels;
+    std::vector<Consumer> consumers;
+    uint32_t nextPointerBase;
+    uint32_t drawing; // slot target() handed out
+    uint64_t frameNumber;
+
+    void acceptConsumers() {
+        for (;;) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            Consumer c;
+            c.socketFd = fd;
+            c.eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            c.pointerBase = nextPointerBase;
+            memset(&c.partial, 0, sizeof(c.partial));
+            c.partialBytes = 0;
+            // A block of pointer ids each, so consumers' fingers never mix
+            nextPointerBase += 0x100;
+            if (c.eventFd < 0 || !sendFds(c)) {
+                if (c.eventFd >= 0) close(c.eventFd);
+                close(fd);
+                continue;
+            }
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+            consumers.push_back(c);
+        }
+    }
+
+    bool sendFds(const Consumer& c) {
+        std::vector<int> fds;
+        fds.push_back(headerFd);
+        fds.push_back(c.eventFd);
+        fds.insert(fds.end(), slotFds.begin(), slotFds.end());
+
+        FrameExportHello hello = { FRAME_EXPORT_MAGIC, static_cast<uint32_t>(fds.size()) };
+        struct iovec iov = { &hello, sizeof(hello) };
+        char control[CMSG_SPACE(sizeof(int) * (2 + FRAME_EXPORT_MAX_SLOTS))];
+        memset(control, 0, sizeof(control));
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+        // A fresh socket's buffer always has room for this
+        return sendmsg(c.socketFd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(hello));
+    }
+
+    void dropConsumer(size_t i, InputQueue<1024>& input) {
+        Consumer& c = consumers[i];
+        for (uint32_t pointer : c.pointersDown) input.release(pointer);
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, c.socketFd, nullptr);
+        close(c.socketFd);
+        close(c.eventFd);
+        consumers.erase(consumers.begin() + i);
+    }
+
+    // Returns false once the consumer has hung up
+    static bool readPointers(Consumer& c, InputQueue<1024>& input, bool& queued) {
+        char* partial = reinterpret_cast<char*>(&c.partial);
+        for (;;) {
+            ssize_t n = recv(c.socketFd, partial + c.partialBytes, sizeof(c.partial) - c.partialBytes, 0);
+            if (n == 0) return false;
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            c.partialBytes += static_cast<size_t>(n);
+            if (c.partialBytes < sizeof(c.partial)) continue;
+            c.partialBytes = 0;
+
+            uint32_t pointer = c.pointerBase + (c.partial.pointer & 0xFF);
+            std::vector<uint32_t>::iterator down = std::find(c.pointersDown.begin(), c.pointersDown.end(), pointer);
+            if (c.partial.released) {
+                if (down == c.pointersDown.end()) continue;
+                c.pointersDown.erase(down);
+                input.release(pointer);
+            } else {
+                if (down == c.pointersDown.end()) c.pointersDown.push_back(pointer);
+                input.push(c.partial.x, c.partial.y, pointer);
+            }
+            queued = true;
+        }
+    }
+
+public:
+    FrameExporter() : listenFd(-1), epollFd(-1), headerFd(-1), header(nullptr), slotBytes(0),
+                      nextPointerBase(0x100), drawing(0), frameNumber(0) {}
+
+    ~FrameExporter() { stop(); }
+
+    bool active() const { return listenFd >= 0; }
+    size_t consumerCount() const { return consumers.size(); }
+
+    // Readable when a consumer connects or sends input
+    int fd() const { return epollFd; }
+
+    bool start(const std::string& socketPath, int width, int height, int slotCount, std::string& error) {
+        if (slotCount < 2 || slotCount > FRAME_EXPORT_MAX_SLOTS) {
+            error = "slot count must be 2 to " + std::to_string(static_cast<int>(FRAME_EXPORT_MAX_SLOTS));
+            return false;
+        }
+        size_t stride = static_cast<size_t>(width) * 4;
+        slotBytes = stride * height;
+        // The header only has 32 bits for the size of a buffer
+        if (width <= 0 || height <= 0 || slotBytes / height != stride || slotBytes > UINT32_MAX) {
+            error = "frames must be under 4GB";
+            slotBytes = 0;
+            return false;
+        }
+
+        header = static_cast<FrameRingHeader*>(frame_export::createShared("google-balls-control", sizeof(FrameRingHeader), headerFd));
+        if (!header) { error = strerror(errno); stop(); return false; }
+        header = new (header) FrameRingHeader();
+        header->magic = FRAME_EXPORT_MAGIC;
+        header->version = FRAME_EXPORT_VERSION;
+        header->width = width;
+        header->height = height;
+        header->stride = static_cast<uint32_t>(stride);
+        header->format = FRAME_FORMAT_XRGB8888;
+        header->slotCount = slotCount;
+        header->slotBytes = static_cast<uint32_t>(slotBytes);
+        header->latestSlot.store(static_cast<uint32_t>(slotCount - 1), std::memory_order_relaxed);
+
+        for (int i = 0; i < slotCount; i++) {
+            int fd;
+            void* pixels = frame_export::createShared("google-balls-frame", slotBytes, fd);
+            if (!pixels) { error = strerror(errno); stop(); return false; }
+            slotFds.push_back(fd);
+            slotPixels.push_back(static_cast<uint32_t*>(pixels));
+        }
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+            error = "bad socket path";
+            stop();
+            return false;
+        }
+        strcpy(addr.sun_path, socketPath.c_str());
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) { error = strerror(errno); stop(); return false; }
+        // Replace a stale socket from an earlier run, but nothing else
+        struct stat st;
+        if (lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socketPath.c_str());
+        if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listenFd, 16) < 0) {
+            error = strerror(errno);
+            stop();
+            return false;
+        }
+        unixPath = socketPath;
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = listenFd;
+        if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) < 0) {
+            error = strerror(errno);
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        InputQueue<1024> unused;
+        while (!consumers.empty()) dropConsumer(consumers.size() - 1, unused);
+        if (epollFd >= 0) close(epollFd);
+        epollFd = -1;
+        if (listenFd >= 0) close(listenFd);
+        listenFd = -1;
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+        unixPath.clear();
+        for (size_t i = 0; i < slotFds.size(); i++) {
+            munmap(slotPixels[i], slotBytes);
+            close(slotFds[i]);
+        }
+        slotFds.clear();
+        slotPixels.clear();
+        if (header) munmap(header, sizeof(FrameRingHeader));
+        header = nullptr;
+        if (headerFd >= 0) close(headerFd);
+        headerFd = -1;
+    }
+
+    // Takes new consumers and their pointer input. Returns true when input
+    // was queued, so the caller can wake the physics.
+    bool dispatch(InputQueue<1024>& input) {
+        struct epoll_event events[16];
+        int count = epoll_wait(epollFd, events, 16, 0);
+        bool queued = false;
+        for (int e = 0; e < count; e++) {
+            if (events[e].data.fd == listenFd) {
+                acceptConsumers();
+                continue;
+            }
+            for (size_t i = 0; i < consumers.size(); i++) {
+                if (consumers[i].socketFd != events[e].data.fd) continue;
+                if (!readPointers(consumers[i], input, queued)) dropConsumer(i, input);
+                break;
+            }
+        }
+        return queued;
+    }
+
+    // The buffer after the newest one, marked as being drawn. Consumers
+    // still reading it from slotCount - 1 frames ago will see it torn.
+    raster::Target target() {
+        drawing = (header->latestSlot.load(std::memory_order_relaxed) + 1) % header->slotCount;
+        FrameSlot& slot = header->slots[drawing];
+        slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        raster::Target t = { slotPixels[drawing], static_cast<int>(header->stride / 4),
+                             static_cast<int>(header->width), static_cast<int>(header->height) };
+        return t;
+    }
+
+    // Makes the frame drawn into target() the newest and wakes every consumer
+    void publish(uint64_t timestampUs) {
+        frameNumber++;
+        FrameSlot& slot = header->slots[drawing];
+        slot.frameNumber.store(frameNumber, std::memory_order_relaxed);
+        slot.timestampUs.store(timestampUs, std::memory_order_relaxed);
+        slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+        uint32_t sequence = header->sequence.load(std::memory_order_relaxed);
+        header->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->latestSlot.store(drawing, std::memory_order_relaxed);
+        header->frameNumber.store(frameNumber, std::memory_order_relaxed);
+        header->timestampUs.store(timestampUs, std::memory_order_relaxed);
+        header->sequence.store(sequence + 2, std::memory_order_release);
+
+        // Only fails when the counter is saturated, and then it's set anyway
+        uint64_t one = 1;
+        for (const auto& c : consumers) {
+            ssize_t written = write(c.eventFd, &one, sizeof(one));
+            (void)written;
+        }
+    }
+};
+
+// Consumer side, for whatever wants the frames: connect(), poll eventFd()
+// and read it to clear it, then take latest() and use the pixels in place.
+class FrameImporter {
+public:
+    struct Frame {
+        const uint32_t* pixels;
+        uint64_t frameNumber;
+        uint64_t timestampUs;
+        uint32_t slot;
+        uint32_t slotSequence;
+    };
+
+private:
+    int socketFd;
+    int headerFd;
+    int eventFd_;
+    const FrameRingHeader* header;
+    std::vector<int> slotFds;
+    std::vector<const uint32_t*> slotPixels;
+
+public:
+    FrameImporter() : socketFd(-1), headerFd(-1), eventFd_(-1), header(nullptr) {}
+    ~FrameImporter() { disconnect(); }
+
+    int eventFd() const { return eventFd_; }
+    int width() const { return static_cast<int>(header->width); }
+    int height() const { return static_cast<int>(header->height); }
+    int stride() const { return static_cast<int>(header->stride); } // bytes
+
+    bool connect(const std::string& socketPath, std::string& error) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+            error = "bad socket path";
+            return false;
+        }
+        strcpy(addr.sun_path, socketPath.c_str());
+        socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (socketFd < 0 || ::connect(socketFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+            error = strerror(errno);
+            disconnect();
+            return false;
+        }
+
+        FrameExportHello hello;
+        struct iovec iov = { &hello, sizeof(hello) };
+        char control[CMSG_SPACE(sizeof(int) * (2 + FRAME_EXPORT_MAX_SLOTS))];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC);
+        struct cmsghdr* cmsg = n == sizeof(hello) ? CMSG_FIRSTHDR(&msg) : nullptr;
+        if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || hello.magic != FRAME_EXPORT_MAGIC) {
+            error = "not a frame export socket";
+            disconnect();
+            return false;
+        }
+        std::vector<int> fds((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * fds.size());
+        if (fds.size() < 3 || fds.size() != hello.fdCount) {
+            for (int fd : fds) close(fd);
+            error = "frame export sent the wrong fds";
+            disconnect();
+            return false;
+        }
+        headerFd = fds[0];
+        eventFd_ = fds[1];
+        slotFds.assign(fds.begin() + 2, fds.end());
+
+        void* mapped = mmap(nullptr, sizeof(FrameRingHeader), PROT_READ, MAP_SHARED, headerFd, 0);
+        if (mapped == MAP_FAILED) { error = strerror(errno); disconnect(); return false; }
+        header = static_cast<const FrameRingHeader*>(mapped);
+        if (header->version != FRAME_EXPORT_VERSION || header->format != FRAME_FORMAT_XRGB8888 ||
+            header->slotCount != slotFds.size()) {
+            error = "unsupported frame export version";
+            disconnect();
+            return false;
+        }
+        for (int fd : slotFds) {
+            mapped = mmap(nullptr, header->slotBytes, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped == MAP_FAILED) { error = strerror(errno); disconnect(); return false; }
+            slotPixels.push_back(static_cast<const uint32_t*>(mapped));
+        }
+        return true;
+    }
+
+    void disconnect() {
+        for (size_t i = 0; i < slotPixels.size(); i++) munmap(const_cast<uint32_t*>(slotPixels[i]), header->slotBytes);
+        slotPixels.clear();
+        for (int fd : slotFds) close(fd);
+        slotFds.clear();
+        if (header) munmap(const_cast<FrameRingHeader*>(header), sizeof(FrameRingHeader));
+        header = nullptr;
+        if (headerFd >= 0) close(headerFd);
+        if (eventFd_ >= 0) close(eventFd_);
+        if (socketFd >= 0) close(socketFd);
+        headerFd = eventFd_ = socketFd = -1;
+    }
+
+    // The newest finished frame, false before the first one
+    bool latest(Frame& out) const {
+        for (;;) {
+            uint32_t before = header->sequence.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            uint32_t slot = header->latestSlot.load(std::memory_order_relaxed);
+            uint64_t frameNumber = header->frameNumber.load(std::memory_order_relaxed);
+            uint64_t timestampUs = header->timestampUs.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->sequence.load(std::memory_order_relaxed) != before) continue;
+            if (!frameNumber) return false;
+
+            // The slot may already be drawn over if this process was slow
+            // between the two reads; then there is a newer frame to take
+            const FrameSlot& s = header->slots[slot % header->slotCount];
+            uint32_t slotSequence = s.sequence.load(std::memory_order_acquire);
+            if ((slotSequence & 1) || s.frameNumber.load(std::memory_order_relaxed) != frameNumber) continue;
+
+            out.pixels = slotPixels[slot % header->slotCount];
+            out.frameNumber = frameNumber;
+            out.timestampUs = timestampUs;
+            out.slot = slot % header->slotCount;
+            out.slotSequence = slotSequence;
+            return true;
+        }
+    }
+
+    // After reading a frame's pixels: false if the producer started drawing
+    // over them meanwhile, and what was read should be thrown away
+    bool valid(const Frame& frame) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return header->slots[frame.slot].sequence.load(std::memory_order_relaxed) == frame.slotSequence;
+    }
+
+    // Pushes the balls from the consumer's side; pointer is any small id of
+    // the consumer's choosing, x and y are frame pixels
+    bool sendPointer(uint32_t pointer, float x, float y, bool released = false) {
+        FramePointerMessage message = { pointer, released ? 1u : 0u, x, y };
+        return send(socketFd, &message, sizeof(message), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(message));
+    }
+};
+
+#endif
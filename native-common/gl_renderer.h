@@ -0,0 +1,370 @@
+#ifndef GL_RENDERER_H
+#define GL_RENDERER_H
+
+// Draws the balls with OpenGL ES 2 instead of the software rasterizer. Every
+// ball is one instanced quad, and the fragment shader works out the circle
+// from its distance to the centre (anti-aliased over one pixel like
+// raster::drawDisc), so the CPU never touches a pixel.
+//
+// Ball data goes up as separate arrays per attribute (where the ball was last
+// tick, where it is now, its colour) and only when a new snapshot arrives;
+// frames in between just move a uniform, the vertex shader interpolates. The
+// view transform is a uniform too, so a resize doesn't upload anything.
+//
+// Instancing isn't core in ES 2: ES 3 contexts (which Mesa hands out even
+// when asked for 2, llvmpipe included) use the core calls, otherwise one of
+// the *_instanced_arrays extensions. Without any, every ball gets its six
+// vertices written out instead.
+//
+// All GL calls go through pointers from the port's loader, so nothing links
+// against libGLESv2 directly.
+
+// Ports can include their windowing library's copy of the header first, like
+// SDL2's SDL_opengles2.h with SDL_USE_BUILTIN_OPENGL_DEFINITIONS, and then
+// need no system GLES headers at all
+#ifndef __gles2_gl2_h_
+#include <GLES2/gl2.h>
+#endif
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "simulation.h"
+
+class GlRenderer {
+public:
+    typedef void* (*GetProc)(const char* name);
+
+private:
+    // Same signature for the core, ANGLE, EXT and NV versions
+    typedef void (GL_APIENTRYP DrawArraysInstancedFn)(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+    typedef void (GL_APIENTRYP VertexAttribDivisorFn)(GLuint index, GLuint divisor);
+
+    struct Functions {
+        PFNGLCREATESHADERPROC CreateShader;
+        PFNGLSHADERSOURCEPROC ShaderSource;
+        PFNGLCOMPILESHADERPROC CompileShader;
+        PFNGLGETSHADERIVPROC GetShaderiv;
+        PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+        PFNGLDELETESHADERPROC DeleteShader;
+        PFNGLCREATEPROGRAMPROC CreateProgram;
+        PFNGLATTACHSHADERPROC AttachShader;
+        PFNGLBINDATTRIBLOCATIONPROC BindAttribLocation;
+        PFNGLLINKPROGRAMPROC LinkProgram;
+        PFNGLGETPROGRAMIVPROC GetProgramiv;
+        PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+        PFNGLDELETEPROGRAMPROC DeleteProgram;
+        PFNGLUSEPROGRAMPROC UseProgram;
+        PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+        PFNGLUNIFORM1FPROC Uniform1f;
+        PFNGLUNIFORM2FPROC Uniform2f;
+        PFNGLUNIFORM3FPROC Uniform3f;
+        PFNGLGENBUFFERSPROC GenBuffers;
+        PFNGLDELETEBUFFERSPROC DeleteBuffers;
+        PFNGLBINDBUFFERPROC BindBuffer;
+        PFNGLBUFFERDATAPROC BufferData;
+        PFNGLBUFFERSUBDATAPROC BufferSubData;
+        PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+        PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+        PFNGLVIEWPORTPROC Viewport;
+        PFNGLCLEARCOLORPROC ClearColor;
+        PFNGLCLEARPROC Clear;
+        PFNGLENABLEPROC Enable;
+        PFNGLDISABLEPROC Disable;
+        PFNGLBLENDFUNCSEPARATEPROC BlendFuncSeparate;
+        PFNGLDRAWARRAYSPROC DrawArrays;
+        PFNGLGETSTRINGPROC GetString;
+        DrawArraysInstancedFn DrawArraysInstanced;
+        VertexAttribDivisorFn VertexAttribDivisor;
+    } gl;
+
+    enum { CORNER, PREV, CUR, COLOR, STREAMS };
+
+    GLuint program;
+    GLuint buffers[STREAMS];
+    GLint alphaUniform, viewUniform, scaleUniform, toClipUniform;
+    const char* instancing; // which calls are used, nullptr for none
+
+    // One entry per ball when instancing, six otherwise
+    std::vector<GLfloat> prevDiscs, curDiscs; // x, y, radius in layout coordinates
+    std::vector<GLubyte> colors;               // r, g, b, a
+    size_t uploadedBalls;     // balls the GPU buffers currently describe
+    size_t bufferVertices;    // what they were allocated for
+    uint64_t uploadedSequence;
+
+    static const char* vertexSource() {
+        return
+            "attribute vec2 corner;\n"   // -1..1 across the quad
+            "attribute vec3 prevDisc;\n" // x, y, radius last tick
+            "attribute vec3 curDisc;\n"
+            "attribute vec4 color;\n"
+            "uniform float alpha;\n"     // how far between the two ticks
+            "uniform vec3 view;\n"       // layout to window: offset x, y and scale
+            "uniform float scale;\n"     // window coordinates to pixels
+            "uniform vec2 toClip;\n"     // pixels to clip space
+            "varying vec2 local;\n"
+            "varying float radius;\n"
+            "varying vec4 fill;\n"
+            "void main() {\n"
+            "    vec3 disc = mix(prevDisc, curDisc, alpha);\n"
+            "    radius = max(disc.z, 1.0) * view.z * scale;\n"
+            "    local = corner * (radius + 1.0);\n" // room for the soft edge
+            "    fill = color;\n"
+            // raster.h takes a pixel's corner as its position, GL its centre
+            "    vec2 pixel = (disc.xy * view.z + view.xy) * scale + 0.5 + local;\n"
+            "    gl_Position = vec4(pixel * toClip + vec2(-1.0, 1.0), 0.0, 1.0);\n"
+            "}\n";
+    }
+
+    static const char* fragmentSource() {
+        return
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+            "precision highp float;\n"
+            "#else\n"
+            "precision mediump float;\n"
+            "#endif\n"
+            "varying vec2 local;\n"
+            "varying float radius;\n"
+            "varying vec4 fill;\n"
+            "void main() {\n"
+            "    float coverage = clamp(radius + 0.5 - length(local), 0.0, 1.0);\n"
+            "    gl_FragColor = vec4(fill.rgb, fill.a * coverage);\n"
+            "}\n";
+    }
+
+    template<typename Fn>
+    bool load(Fn& fn, GetProc getProc, const char* name) {
+        fn = reinterpret_cast<Fn>(getProc(name));
+        return fn != nullptr;
+    }
+
+    bool loadFunctions(GetProc getProc) {
+        bool ok = true;
+#define GL_RENDERER_LOAD(name) ok = load(gl.name, getProc, "gl" #name) && ok
+        GL_RENDERER_LOAD(CreateShader); GL_RENDERER_LOAD(ShaderSource); GL_RENDERER_LOAD(CompileShader);
+        GL_RENDERER_LOAD(GetShaderiv); GL_RENDERER_LOAD(GetShaderInfoLog); GL_RENDERER_LOAD(DeleteShader);
+        GL_RENDERER_LOAD(CreateProgram); GL_RENDERER_LOAD(AttachShader); GL_RENDERER_LOAD(BindAttribLocation);
+        GL_RENDERER_LOAD(LinkProgram); GL_RENDERER_LOAD(GetProgramiv); GL_RENDERER_LOAD(GetProgramInfoLog);
+        GL_RENDERER_LOAD(DeleteProgram); GL_RENDERER_LOAD(UseProgram); GL_RENDERER_LOAD(GetUniformLocation);
+        GL_RENDERER_LOAD(Uniform1f); GL_RENDERER_LOAD(Uniform2f); GL_RENDERER_LOAD(Uniform3f); GL_RENDERER_LOAD(GenBuffers);
+        GL_RENDERER_LOAD(DeleteBuffers); GL_RENDERER_LOAD(BindBuffer); GL_RENDERER_LOAD(BufferData);
+        GL_RENDERER_LOAD(BufferSubData); GL_RENDERER_LOAD(EnableVertexAttribArray);
+        GL_RENDERER_LOAD(VertexAttribPointer); GL_RENDERER_LOAD(Viewport); GL_RENDERER_LOAD(ClearColor);
+        GL_RENDERER_LOAD(Clear); GL_RENDERER_LOAD(Enable); GL_RENDERER_LOAD(Disable);
+        GL_RENDERER_LOAD(BlendFuncSeparate); GL_RENDERER_LOAD(DrawArrays); GL_RENDERER_LOAD(GetString);
+#undef GL_RENDERER_LOAD
+        return ok;
+    }
+
+    static bool hasExtension(const char* extensions, const char* name) {
+        size_t length = strlen(name);
+        for (const char* p = extensions; p && (p = strstr(p, name)); p += length) {
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) return true;
+        }
+        return false;
+    }
+
+    void pickInstancing(GetProc getProc) {
+        instancing = nullptr;
+        const char* version = reinterpret_cast<const char*>(gl.GetString(GL_VERSION));
+        const char* extensions = reinterpret_cast<const char*>(gl.GetString(GL_EXTENSIONS));
+        // "OpenGL ES 3.2 Mesa ..."
+        if (version && strncmp(version, "OpenGL ES ", 10) == 0 && version[10] >= '3' &&
+            load(gl.DrawArraysInstanced, getProc, "glDrawArraysInstanced") &&
+            load(gl.VertexAttribDivisor, getProc, "glVertexAttribDivisor")) {
+            instancing = "core";
+            return;
+        }
+        static const char* const suffixes[] = { "ANGLE", "EXT", "NV" };
+        for (const char* suffix : suffixes) {
+            char name[64];
+            snprintf(name, sizeof(name), "GL_%s_instanced_arrays", suffix);
+            if (!hasExtension(extensions, name)) continue;
+            char draw[64], divisor[64];
+            snprintf(draw, sizeof(draw), "glDrawArraysInstanced%s", suffix);
+            snprintf(divisor, sizeof(divisor), "glVertexAttribDivisor%s", suffix);
+            if (load(gl.DrawArraysInstanced, getProc, draw) && load(gl.VertexAttribDivisor, getProc, divisor)) {
+                instancing = suffix;
+                return;
+            }
+        }
+    }
+
+    GLuint compile(GLenum type, const char* source) {
+        GLuint shader = gl.CreateShader(type);
+        gl.ShaderSource(shader, 1, &source, nullptr);
+        gl.CompileShader(shader);
+        GLint ok = 0;
+        gl.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            char log[1024];
+            gl.GetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            fprintf(stderr, "Ball shader failed to compile: %s\n", log);
+            gl.DeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    bool link() {
+        GLuint vertex = compile(GL_VERTEX_SHADER, vertexSource());
+        GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentSource());
+        if (!vertex || !fragment) {
+            if (vertex) gl.DeleteShader(vertex);
+            if (fragment) gl.DeleteShader(fragment);
+            return false;
+        }
+        program = gl.CreateProgram();
+        gl.AttachShader(program, vertex);
+        gl.AttachShader(program, fragment);
+        gl.BindAttribLocation(program, CORNER, "corner");
+        gl.BindAttribLocation(program, PREV, "prevDisc");
+        gl.BindAttribLocation(program, CUR, "curDisc");
+        gl.BindAttribLocation(program, COLOR, "color");
+        gl.LinkProgram(program);
+        gl.DeleteShader(vertex);
+        gl.DeleteShader(fragment);
+        GLint ok = 0;
+        gl.GetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (!ok) {
+            char log[1024];
+            gl.GetProgramInfoLog(program, sizeof(log), nullptr, log);
+            fprintf(stderr, "Ball shader failed to link: %s\n", log);
+            gl.DeleteProgram(program);
+            program = 0;
+            return false;
+        }
+        alphaUniform = gl.GetUniformLocation(program, "alpha");
+        viewUniform = gl.GetUniformLocation(program, "view");
+        scaleUniform = gl.GetUniformLocation(program, "scale");
+        toClipUniform = gl.GetUniformLocation(program, "toClip");
+        return true;
+    }
+
+    // Fills the arrays from the snapshot and sends them up, growing the GPU
+    // buffers only when there are more balls than ever before
+    void upload(const SimulationSnapshot& snapshot) {
+        size_t balls = snapshot.balls.size();
+        size_t repeat = instancing ? 1 : 6;
+        size_t vertices = balls * repeat;
+        prevDiscs.resize(vertices * 3);
+        curDiscs.resize(vertices * 3);
+        colors.resize(vertices * 4);
+        for (size_t i = 0; i < balls; i++) {
+            const BallState& ball = snapshot.balls[i];
+            for (size_t k = 0; k < repeat; k++) {
+                size_t v = i * repeat + k;
+                prevDiscs[v * 3] = static_cast<GLfloat>(ball.prevPos.x);
+                prevDiscs[v * 3 + 1] = static_cast<GLfloat>(ball.prevPos.y);
+                prevDiscs[v * 3 + 2] = static_cast<GLfloat>(ball.size * ball.prevPos.z);
+                curDiscs[v * 3] = static_cast<GLfloat>(ball.curPos.x);
+                curDiscs[v * 3 + 1] = static_cast<GLfloat>(ball.curPos.y);
+                curDiscs[v * 3 + 2] = static_cast<GLfloat>(ball.size * ball.curPos.z);
+                colors[v * 4] = ball.color.r;
+                colors[v * 4 + 1] = ball.color.g;
+                colors[v * 4 + 2] = ball.color.b;
+                colors[v * 4 + 3] = ball.color.a;
+            }
+        }
+
+        if (vertices > bufferVertices) {
+            bufferVertices = vertices;
+            // The corners repeat the same six for every ball
+            static const GLfloat quad[12] = { -1, -1, 1, -1, -1, 1, -1, 1, 1, -1, 1, 1 };
+            std::vector<GLfloat> corners(instancing ? 12 : vertices * 2);
+            for (size_t i = 0; i < corners.size(); i++) corners[i] = quad[i % 12];
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[CORNER]);
+            gl.BufferData(GL_ARRAY_BUFFER, corners.size() * sizeof(GLfloat), corners.data(), GL_STATIC_DRAW);
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[PREV]);
+            gl.BufferData(GL_ARRAY_BUFFER, prevDiscs.size() * sizeof(GLfloat), prevDiscs.data(), GL_DYNAMIC_DRAW);
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[CUR]);
+            gl.BufferData(GL_ARRAY_BUFFER, curDiscs.size() * sizeof(GLfloat), curDiscs.data(), GL_DYNAMIC_DRAW);
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[COLOR]);
+            gl.BufferData(GL_ARRAY_BUFFER, colors.size(), colors.data(), GL_DYNAMIC_DRAW);
+        } else if (vertices) {
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[PREV]);
+            gl.BufferSubData(GL_ARRAY_BUFFER, 0, prevDiscs.size() * sizeof(GLfloat), prevDiscs.data());
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[CUR]);
+            gl.BufferSubData(GL_ARRAY_BUFFER, 0, curDiscs.size() * sizeof(GLfloat), curDiscs.data());
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[COLOR]);
+            gl.BufferSubData(GL_ARRAY_BUFFER, 0, colors.size(), colors.data());
+        }
+        uploadedBalls = balls;
+        uploadedSequence = snapshot.sequence;
+    }
+
+    void bindStreams() {
+        static const GLint sizes[STREAMS] = { 2, 3, 3, 4 };
+        for (GLuint i = 0; i < STREAMS; i++) {
+            gl.BindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            gl.EnableVertexAttribArray(i);
+            if (i == COLOR) gl.VertexAttribPointer(i, sizes[i], GL_UNSIGNED_BYTE, GL_TRUE, 0, nullptr);
+            else gl.VertexAttribPointer(i, sizes[i], GL_FLOAT, GL_FALSE, 0, nullptr);
+            if (instancing) gl.VertexAttribDivisor(i, i == CORNER ? 0 : 1);
+        }
+    }
+
+public:
+    GlRenderer() : program(0), alphaUniform(-1), viewUniform(-1), scaleUniform(-1), toClipUniform(-1), instancing(nullptr),
+                   uploadedBalls(0), bufferVertices(0), uploadedSequence(0) {
+        memset(&gl, 0, sizeof(gl));
+        memset(buffers, 0, sizeof(buffers));
+    }
+
+    // Needs the port's ES 2 (or later) context current. False, with the
+    // reason on stderr, when it can't be used; the port then falls back to
+    // the software rasterizer.
+    bool init(GetProc getProc) {
+        if (!loadFunctions(getProc)) {
+            fprintf(stderr, "OpenGL ES 2 functions missing\n");
+            return false;
+        }
+        pickInstancing(getProc);
+        if (!link()) return false;
+        gl.GenBuffers(STREAMS, buffers);
+        return true;
+    }
+
+    void destroy() {
+        if (buffers[0]) gl.DeleteBuffers(STREAMS, buffers);
+        if (program) gl.DeleteProgram(program);
+        memset(buffers, 0, sizeof(buffers));
+        program = 0;
+        bufferVertices = uploadedBalls = 0;
+        uploadedSequence = 0;
+    }
+
+    // "core", "ANGLE", "EXT", "NV", or "none" for six vertices a ball
+    const char* instancingName() const { return instancing ? instancing : "none"; }
+
+    // Clears to white and draws the snapshot, alpha of the way from the
+    // previous tick to this one, placed by the snapshot's view. scale maps
+    // window coordinates to the framebuffer's pixels, as in collectDiscs().
+    // originX, originY is where the framebuffer's corner sits in the view's
+    // window coordinates, for one window showing part of a bigger scene.
+    void draw(const SimulationSnapshot& snapshot, double alpha, int framebufferWidth, int framebufferHeight,
+              double scale = 1.0, double originX = 0, double originY = 0) {
+        gl.Viewport(0, 0, framebufferWidth, framebufferHeight);
+        gl.ClearColor(1, 1, 1, 1);
+        gl.Clear(GL_COLOR_BUFFER_BIT);
+        if (snapshot.sequence != uploadedSequence) upload(snapshot);
+        if (!uploadedBalls) return;
+
+        gl.UseProgram(program);
+        gl.Uniform1f(alphaUniform, static_cast<GLfloat>(alpha));
+        const ViewTransform& view = snapshot.view;
+        gl.Uniform3f(viewUniform, static_cast<GLfloat>(view.offsetX - originX), static_cast<GLfloat>(view.offsetY - originY),
+                     static_cast<GLfloat>(view.scale));
+        gl.Uniform1f(scaleUniform, static_cast<GLfloat>(scale));
+        gl.Uniform2f(toClipUniform, 2.0f / framebufferWidth, -2.0f / framebufferHeight);
+        bindStreams();
+        gl.Enable(GL_BLEND);
+        // Destination alpha stays 1, or a compositor would see through the edges
+        gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+        if (instancing) gl.DrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(uploadedBalls));
+        else gl.DrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(uploadedBalls * 6));
+        gl.Disable(GL_BLEND);
+    }
+};
+
+#endif
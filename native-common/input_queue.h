@@ -0,0 +1,76 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+// Carries pointer samples from the window system's callbacks to the
+// simulation tick. Single producer, single consumer and no locks: each side
+// owns one index, and a slot is handed over by the release store of that
+// index, so the producer and the simulation may live on different threads.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct InputSample {
+    double x, y;
+    uint64_t timeUs;  // when the sample was received, see InputQueue::nowUs()
+    uint32_t pointer; // which mouse, finger or stick this came from, 0 is the mouse
+    bool released;    // the pointer went away (finger lifted, pad unplugged); x/y unused
+};
+
+template<size_t Capacity>
+class InputQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    // Kept on separate cache lines so the two threads don't fight over them
+    alignas(64) std::atomic<size_t> head; // next slot to read, consumer owned
+    alignas(64) std::atomic<size_t> tail; // next slot to write, producer owned
+    alignas(64) std::atomic<uint64_t> dropped;
+    InputSample slots[Capacity];
+
+public:
+    InputQueue() : head(0), tail(0), dropped(0) {}
+
+    static uint64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Producer side. Only fails when the consumer has stopped draining; the
+    // sample is then counted and dropped rather than blocking the callback.
+    bool push(const InputSample& sample) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[t & (Capacity - 1)] = sample;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(double x, double y, uint32_t pointer = 0) {
+        InputSample sample = { x, y, nowUs(), pointer, false };
+        return push(sample);
+    }
+
+    bool release(uint32_t pointer) {
+        InputSample sample = { 0, 0, nowUs(), pointer, true };
+        return push(sample);
+    }
+
+    // Consumer side: appends everything queued so far, oldest first.
+    size_t popAll(std::vector<InputSample>& out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        for (size_t i = h; i != t; i++) out.push_back(slots[i & (Capacity - 1)]);
+        head.store(t, std::memory_order_release);
+        return t - h;
+    }
+
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#endif
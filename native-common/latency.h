@@ -0,0 +1,169 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Input-to-photon latency: the time from an input sample arriving to the
+// first frame that reacts to it reaching the screen (presented by the
+// compositor, flushed to the terminal, ...). Values go into a log-linear
+// histogram, eight buckets per power of two so any percentile is within
+// 12.5%, which is cheap enough to update every frame.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+class LatencyHistogram {
+public:
+    // Values below LINEAR microseconds get a bucket each, then SUB_BUCKETS per
+    // power of two up to 2^32us (over an hour); anything longer is clamped
+    enum { LINEAR = 16, SUB_BUCKETS = 8, BUCKETS = LINEAR + (32 - 4) * SUB_BUCKETS };
+
+private:
+    uint64_t buckets[BUCKETS];
+    uint64_t total;
+    uint64_t maxUs;
+
+    static int bucketOf(uint64_t us) {
+        if (us < LINEAR) return static_cast<int>(us);
+        if (us >= (uint64_t(1) << 32)) return BUCKETS - 1;
+        int e = 4;
+        while (us >> (e + 1)) e++;
+        int sub = static_cast<int>(us >> (e - 3)) & (SUB_BUCKETS - 1);
+        return LINEAR + (e - 4) * SUB_BUCKETS + sub;
+    }
+
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        for (auto& b : buckets) b = 0;
+        total = 0;
+        maxUs = 0;
+    }
+
+    // Largest value that lands in bucket i
+    static uint64_t upperBound(int i) {
+        if (i < LINEAR) return static_cast<uint64_t>(i);
+        int e = 4 + (i - LINEAR) / SUB_BUCKETS;
+        uint64_t sub = static_cast<uint64_t>((i - LINEAR) % SUB_BUCKETS);
+        return ((SUB_BUCKETS + sub + 1) << (e - 3)) - 1;
+    }
+
+    void record(uint64_t us) {
+        buckets[bucketOf(us)]++;
+        total++;
+        if (us > maxUs) maxUs = us;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maxUs; }
+    uint64_t bucket(int i) const { return buckets[i]; }
+
+    // p in 0..1. Reports the top of the bucket the percentile falls in, so it
+    // errs on the slow side.
+    uint64_t percentile(double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * total + 0.999999);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) return upperBound(i) < maxUs ? upperBound(i) : maxUs;
+        }
+        return maxUs;
+    }
+
+    // {"count": N, "p50_us": .., "p95_us": .., "p99_us": .., "max_us": .., "buckets": [[le_us, count], ...]}
+    void writeJson(FILE* f) const {
+        fprintf(f, "{\"count\": %llu, \"p50_us\": %llu, \"p95_us\": %llu, \"p99_us\": %llu, \"max_us\": %llu, \"buckets\": [",
+                (unsigned long long)total, (unsigned long long)percentile(0.50),
+                (unsigned long long)percentile(0.95), (unsigned long long)percentile(0.99),
+                (unsigned long long)maxUs);
+        bool first = true;
+        for (int i = 0; i < BUCKETS; i++) {
+            if (!buckets[i]) continue;
+            fprintf(f, "%s[%llu, %llu]", first ? "" : ", ",
+                    (unsigned long long)upperBound(i), (unsigned long long)buckets[i]);
+            first = false;
+        }
+        fprintf(f, "]}");
+    }
+
+    void print(FILE* f, const char* label) const {
+        fprintf(f, "%s: %llu frames, p50 %.1fms, p95 %.1fms, p99 %.1fms, max %.1fms\n", label,
+                (unsigned long long)total, percentile(0.50) / 1000.0, percentile(0.95) / 1000.0,
+                percentile(0.99) / 1000.0, maxUs / 1000.0);
+    }
+};
+
+// Follows input through a frame loop. Input is noted when the simulation
+// consumes it, the next frame built is tagged with the oldest such sample,
+// and the latency is recorded when that frame is presented.
+class InputLatency {
+public:
+    struct FrameTag {
+        uint64_t inputUs; // oldest input the frame reacts to, 0 if none
+    };
+
+private:
+    LatencyHistogram raw;
+    uint64_t pendingUs;  // oldest consumed input not in a frame yet, 0 if none
+    FrameTag inFlight;   // for loops with one frame in flight, see frameSubmitted()
+
+public:
+    InputLatency() : pendingUs(0) {
+        inFlight.inputUs = 0;
+    }
+
+    // Same clock as InputQueue::nowUs()
+    static uint64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void consumed(uint64_t inputUs) {
+        if (!pendingUs || inputUs < pendingUs) pendingUs = inputUs;
+    }
+
+    // For frames whose fate is reported later, possibly after the next frame
+    // was submitted: tag each one and hand the tag back when it is presented
+    FrameTag tagFrame() {
+        FrameTag tag = { pendingUs };
+        pendingUs = 0;
+        return tag;
+    }
+
+    void presented(const FrameTag& tag, uint64_t presentUs) {
+        if (!tag.inputUs) return;
+        uint64_t latency = presentUs > tag.inputUs ? presentUs - tag.inputUs : 0;
+        raw.record(latency);
+    }
+
+    // The frame was never shown (the compositor dropped it); its input rides
+    // along with the next one instead
+    void discarded(const FrameTag& tag) {
+        if (tag.inputUs) consumed(tag.inputUs);
+    }
+
+    // Same for loops that only ever have one frame in flight
+    void frameSubmitted() {
+        if (pendingUs) inFlight = tagFrame();
+    }
+
+    void presented(uint64_t presentUs) {
+        presented(inFlight, presentUs);
+        inFlight.inputUs = 0;
+    }
+
+    void discarded() {
+        discarded(inFlight);
+        inFlight.inputUs = 0;
+    }
+
+    const LatencyHistogram& histogram() const { return raw; }
+
+    void print(FILE* f) const {
+        raw.print(f, "input to photon");
+    }
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+// Software rasterizer for the ports that draw into a plain ARGB8888 buffer.
+// Discs are drawn a scanline at a time: the analytic circle edge gives each
+// row's fully covered span and its anti-aliased ends, so there is one sqrt
+// per row rather than per pixel. The covered span is blended with a SIMD
+// routine picked at startup for the running CPU.
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RASTER_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RASTER_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace raster {
+
+struct Target {
+    uint32_t* pixels;
+    int stride; // in pixels
+    int width, height;
+};
+
+// Centre and radius in pixels, colour as straight-alpha ARGB.
+struct Disc {
+    float x, y, r;
+    uint32_t argb;
+};
+
+// out = (src * a + dst * (256 - a)) >> 8 per channel, a in 0..256.
+static inline uint32_t blendPixel(uint32_t dst, uint32_t src, uint32_t a) {
+    uint32_t na = 256 - a;
+    uint32_t rb = (((src & 0x00FF00FF) * a + (dst & 0x00FF00FF) * na) >> 8) & 0x00FF00FF;
+    uint32_t g = (((src & 0x0000FF00) * a + (dst & 0x0000FF00) * na) >> 8) & 0x0000FF00;
+    return 0xFF000000 | rb | g;
+}
+
+// Blends count pixels towards src with a constant a (0..256). a == 256 is a
+// plain fill.
+typedef void (*SpanFn)(uint32_t* dst, int count, uint32_t src, uint32_t a);
+
+static void spanScalar(uint32_t* dst, int count, uint32_t src, uint32_t a) {
+    if (a >= 256) {
+        std::fill(dst, dst + count, src | 0xFF000000);
+        return;
+    }
+    for (int i = 0; i < count; i++) dst[i] = blendPixel(dst[i], src, a);
+}
+
+#ifdef RASTER_X86
+__attribute__((target("sse2")))
+static void spanSse2(uint32_t* dst, int count, uint32_t src, uint32_t a) {
+    int i = 0;
+    if (a >= 256) {
+        __m128i s = _mm_set1_epi32(static_cast<int>(src | 0xFF000000));
+        for (; i + 4 <= count; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+    } else {
+        __m128i zero = _mm_setzero_si128();
+        __m128i s = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(src)), zero);
+        __m128i va = _mm_set1_epi16(static_cast<short>(a));
+        __m128i vna = _mm_set1_epi16(static_cast<short>(256 - a));
+        __m128i sa = _mm_mullo_epi16(s, va);
+        __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+        for (; i + 4 <= count; i += 4) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+            __m128i lo = _mm_unpacklo_epi8(d, zero);
+            __m128i hi = _mm_unpackhi_epi8(d, zero);
+            lo = _mm_srli_epi16(_mm_add_epi16(sa, _mm_mullo_epi16(lo, vna)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(sa, _mm_mullo_epi16(hi, vna)), 8);
+            __m128i out = _mm_or_si128(_mm_packus_epi16(lo, hi), alpha);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+        }
+    }
+    spanScalar(dst + i, count - i, src, a);
+}
+
+__attribute__((target("avx2")))
+static void spanAvx2(uint32_t* dst, int count, uint32_t src, uint32_t a) {
+    int i = 0;
+    if (a >= 256) {
+        __m256i s = _mm256_set1_epi32(static_cast<int>(src | 0xFF000000));
+        for (; i + 8 <= count; i += 8) _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), s);
+    } else {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i s = _mm256_unpacklo_epi8(_mm256_set1_epi32(static_cast<int>(src)), zero);
+        __m256i va = _mm256_set1_epi16(static_cast<short>(a));
+        __m256i vna = _mm256_set1_epi16(static_cast<short>(256 - a));
+        __m256i sa = _mm256_mullo_epi16(s, va);
+        __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+        for (; i + 8 <= count; i += 8) {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+            // unpack/pack work within 128-bit lanes, so pixel order survives
+            __m256i lo = _mm256_unpacklo_epi8(d, zero);
+            __m256i hi = _mm256_unpackhi_epi8(d, zero);
+            lo = _mm256_srli_epi16(_mm256_add_epi16(sa, _mm256_mullo_epi16(lo, vna)), 8);
+            hi = _mm256_srli_epi16(_mm256_add_epi16(sa, _mm256_mullo_epi16(hi, vna)), 8);
+            __m256i out = _mm256_or_si256(_mm256_packus_epi16(lo, hi), alpha);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), out);
+        }
+    }
+    spanSse2(dst + i, count - i, src, a);
+}
+#endif
+
+#ifdef RASTER_NEON
+static void spanNeon(uint32_t* dst, int count, uint32_t src, uint32_t a) {
+    int i = 0;
+    if (a >= 256) {
+        uint32x4_t s = vdupq_n_u32(src | 0xFF000000);
+        for (; i + 4 <= count; i += 4) vst1q_u32(dst + i, s);
+    } else {
+        uint8x16_t s8 = vreinterpretq_u8_u32(vdupq_n_u32(src));
+        uint16x8_t sa = vmulq_n_u16(vmovl_u8(vget_low_u8(s8)), static_cast<uint16_t>(a));
+        uint16_t na = static_cast<uint16_t>(256 - a);
+        uint32x4_t alpha = vdupq_n_u32(0xFF000000);
+        for (; i + 4 <= count; i += 4) {
+            uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+            uint16x8_t lo = vshrq_n_u16(vmlaq_n_u16(sa, vmovl_u8(vget_low_u8(d)), na), 8);
+            uint16x8_t hi = vshrq_n_u16(vmlaq_n_u16(sa, vmovl_u8(vget_high_u8(d)), na), 8);
+            uint32x4_t out = vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+            vst1q_u32(dst + i, vorrq_u32(out, alpha));
+        }
+    }
+    spanScalar(dst + i, count - i, src, a);
+}
+#endif
+
+static SpanFn pickSpan() {
+#ifdef RASTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return spanAvx2;
+    if (__builtin_cpu_supports("sse2")) return spanSse2;
+#endif
+#ifdef RASTER_NEON
+    return spanNeon;
+#endif
+    return spanScalar;
+}
+
+static inline SpanFn span() {
+    static const SpanFn fn = pickSpan();
+    return fn;
+}
+
+static inline void fill(const Target& t, uint32_t argb) {
+    SpanFn fn = span();
+    if (t.stride == t.width) {
+        fn(t.pixels, t.width * t.height, argb, 256);
+        return;
+    }
+    for (int y = 0; y < t.height; y++) fn(t.pixels + y * t.stride, t.width, argb, 256);
+}
+
+// Anti-aliased disc with the same falloff the ports have always used:
+// coverage = clamp(r + 0.5 - distance), pixel centres on integer coordinates.
+static inline void drawDisc(const Target& t, const Disc& d) {
+    const float r = std::max(d.r, 0.5f);
+    const float outer = r + 0.5f;
+    const float inner = r - 0.5f;
+    const uint32_t colorA = (d.argb >> 24) + ((d.argb >> 24) >> 7); // 0..256
+    if (colorA == 0) return;
+
+    int y0 = std::max(0, static_cast<int>(std::ceil(d.y - outer)));
+    int y1 = std::min(t.height - 1, static_cast<int>(std::floor(d.y + outer)));
+    if (y0 > y1) return;
+
+    // Within one pixel of the edge, distance ~= r + (dist^2 - r^2) / 2r, which
+    // gives coverage without a square root.
+    const float r2 = r * r;
+    const float inv2r = 0.5f / r;
+    SpanFn fn = span();
+
+    for (int y = y0; y <= y1; y++) {
+        float dy = y - d.y;
+        float dy2 = dy * dy;
+        float outerW2 = outer * outer - dy2;
+        if (outerW2 <= 0.0f) continue;
+        float outerW = std::sqrt(outerW2);
+        int xa = std::max(0, static_cast<int>(std::ceil(d.x - outerW)));
+        int xb = std::min(t.width - 1, static_cast<int>(std::floor(d.x + outerW)));
+        if (xa > xb) continue;
+
+        // Fully covered span
+        int ia = xb + 1, ib = xb;
+        if (inner > 0.0f && dy2 < inner * inner) {
+            float innerW = std::sqrt(inner * inner - dy2);
+            ia = std::max(xa, static_cast<int>(std::ceil(d.x - innerW)));
+            ib = std::min(xb, static_cast<int>(std::floor(d.x + innerW)));
+            if (ia > ib) { ia = xb + 1; ib = xb; }
+        }
+
+        uint32_t* row = t.pixels + y * t.stride;
+        for (int x = xa; x <= xb; x++) {
+            if (x == ia) {
+                fn(row + ia, ib - ia + 1, d.argb, colorA);
+                x = ib;
+                continue;
+            }
+            float dx = x - d.x;
+            float cov = 0.5f - (dx * dx + dy2 - r2) * inv2r;
+            if (cov <= 0.0f) continue;
+            if (cov > 1.0f) cov = 1.0f;
+            uint32_t a = static_cast<uint32_t>(cov * colorA + 0.5f);
+            if (a) row[x] = blendPixel(row[x], d.argb, a);
+        }
+    }
+}
+
+} // namespace raster
+
+#endif
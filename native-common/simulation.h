@@ -0,0 +1,415 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+// Ball physics shared by the desktop ports that draw through raster.h.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cursor_predictor.h"
+#include "input_queue.h"
+#include "raster.h"
+
+// Balls closer than this to the cursor get pushed away
+static const double REPULSION_RADIUS = 150.0;
+
+struct Vector3 {
+    double x, y, z;
+    Vector3(double x = 0, double y = 0, double z = 0) : x(x), y(y), z(z) {}
+    void set(double newX, double newY, double newZ = 0) { x = newX; y = newY; z = newZ; }
+};
+
+struct Color {
+    uint8_t r, g, b, a;
+    Color(uint8_t r = 255, uint8_t g = 255, uint8_t b = 255, uint8_t a = 255)
+        : r(r), g(g), b(b), a(a) {}
+
+    static Color fromHex(const std::string& hex) {
+        if (hex[0] == '#') {
+            unsigned int value = std::stoul(hex.substr(1), nullptr, 16);
+            return Color((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF, 255);
+        }
+        return Color();
+    }
+
+    uint32_t argb() const {
+        return (uint32_t(a) << 24) | (uint32_t(r) << 16) | (uint32_t(g) << 8) | b;
+    }
+};
+
+// Balls live in the logo's own coordinates; this puts the logo in the
+// window: window = layout * scale + offset. Resizing a window only moves the
+// offset, so balls in flight carry on from where they were.
+struct ViewTransform {
+    double offsetX, offsetY, scale;
+
+    ViewTransform(double offsetX = 0, double offsetY = 0, double scale = 1)
+        : offsetX(offsetX), offsetY(offsetY), scale(scale) {}
+
+    double windowX(double x) const { return x * scale + offsetX; }
+    double windowY(double y) const { return y * scale + offsetY; }
+    double layoutX(double x) const { return (x - offsetX) / scale; }
+    double layoutY(double y) const { return (y - offsetY) / scale; }
+
+    bool operator==(const ViewTransform& o) const {
+        return offsetX == o.offsetX && offsetY == o.offsetY && scale == o.scale;
+    }
+    bool operator!=(const ViewTransform& o) const { return !(*this == o); }
+
+    // A layoutW x layoutH logo in the middle of the window, at its own size
+    static ViewTransform centered(double layoutW, double layoutH, double windowW, double windowH) {
+        return ViewTransform((windowW / 2.0) - (layoutW / 2.0), (windowH / 2.0) - (layoutH / 2.0));
+    }
+};
+
+// What drawing a ball needs: where it was and is this tick, for
+// interpolating between the two, and what it looks like
+struct BallState {
+    Vector3 prevPos, curPos;
+    double size;
+    Color color;
+
+    // The disc at its interpolated position: state = prev * (1-alpha) + cur * alpha,
+    // put in the window by view, then scaled from window coordinates to
+    // buffer pixels
+    raster::Disc disc(double alpha = 1.0, double scale = 1.0, const ViewTransform& view = ViewTransform()) const {
+        double ix = prevPos.x * (1.0 - alpha) + curPos.x * alpha;
+        double iy = prevPos.y * (1.0 - alpha) + curPos.y * alpha;
+        // Radius follows the interpolated z so growing balls stay smooth too
+        double iz = prevPos.z * (1.0 - alpha) + curPos.z * alpha;
+        double ir = size * iz;
+        if (ir < 1) ir = 1;
+
+        raster::Disc d;
+        d.x = static_cast<float>(view.windowX(ix) * scale);
+        d.y = static_cast<float>(view.windowY(iy) * scale);
+        d.r = static_cast<float>(ir * view.scale * scale);
+        d.argb = color.argb();
+        return d;
+    }
+};
+
+class Point {
+public:
+    Vector3 curPos, prevPos, originalPos, targetPos, velocity;
+    Color color;
+    double radius, size;
+    double friction = 0.8;
+    double springStrength = 0.1;
+
+    Point(double x, double y, double z, double size, const std::string& colorHex)
+        : curPos(x, y, z), prevPos(x, y, z), originalPos(x, y, z), targetPos(x, y, z),
+          velocity(0, 0, 0), color(Color::fromHex(colorHex)), radius(size), size(size) {
+    }
+
+    void update() {
+        prevPos = curPos; // Store state before update
+
+        double dx = targetPos.x - curPos.x;
+        double ax = dx * springStrength;
+        velocity.x += ax; velocity.x *= friction;
+        if (std::abs(dx) < 0.1 && std::abs(velocity.x) < 0.01) { curPos.x = targetPos.x; velocity.x = 0; } else { curPos.x += velocity.x; }
+
+        double dy = targetPos.y - curPos.y;
+        double ay = dy * springStrength;
+        velocity.y += ay; velocity.y *= friction;
+        if (std::abs(dy) < 0.1 && std::abs(velocity.y) < 0.01) { curPos.y = targetPos.y; velocity.y = 0; } else { curPos.y += velocity.y; }
+
+        double dox = originalPos.x - curPos.x;
+        double doy = originalPos.y - curPos.y;
+        double dd = (dox * dox) + (doy * doy);
+        double d = std::sqrt(dd);
+
+        targetPos.z = d / 100.0 + 1.0;
+        double dz = targetPos.z - curPos.z;
+        double az = dz * springStrength;
+        velocity.z += az; velocity.z *= friction;
+        if (std::abs(dz) < 0.01 && std::abs(velocity.z) < 0.001) { curPos.z = targetPos.z; velocity.z = 0; } else { curPos.z += velocity.z; }
+
+        radius = size * curPos.z;
+        if (radius < 1) radius = 1;
+    }
+
+    bool moved() const {
+        return curPos.x != prevPos.x || curPos.y != prevPos.y || curPos.z != prevPos.z;
+    }
+
+    BallState state() const {
+        BallState s = { prevPos, curPos, size, color };
+        return s;
+    }
+
+    raster::Disc disc(double alpha = 1.0, double scale = 1.0, const ViewTransform& view = ViewTransform()) const {
+        return state().disc(alpha, scale, view);
+    }
+};
+
+// Everything the renderer needs from one simulation tick, copied out so it
+// can be drawn while the next tick runs
+struct SimulationSnapshot {
+    std::vector<BallState> balls;
+    ViewTransform view; // the one the tick ran with
+    uint64_t sequence; // counts published snapshots, starting at 1
+    uint64_t tickUs;   // when the tick finished, InputQueue::nowUs() clock
+    bool moving;       // false once every ball has come to rest
+
+    SimulationSnapshot() : sequence(0), tickUs(0), moving(false) {}
+
+    void collectDiscs(std::vector<raster::Disc>& discs, double alpha = 1.0, double scale = 1.0) const {
+        discs.clear();
+        for (const auto& ball : balls) discs.push_back(ball.disc(alpha, scale, view));
+    }
+};
+
+struct PointData { int x, y; int size; std::string color; };
+
+// The Google logo: home position, size and colour of every ball, in logo
+// coordinates. Shared by every port that includes this header.
+inline std::vector<PointData> logoPoints() {
+    return {
+        {202, 78, 9, "#ed9d33"}, {348, 83, 9, "#d44d61"}, {256, 69, 9, "#4f7af2"},
+        {214, 59, 9, "#ef9a1e"}, {265, 36, 9, "#4976f3"}, {300, 78, 9, "#269230"},
+        {294, 59, 9, "#1f9e2c"}, {45, 88, 9, "#1c48dd"}, {268, 52, 9, "#2a56ea"},
+        {73, 83, 9, "#3355d8"}, {294, 6, 9, "#36b641"}, {235, 62, 9, "#2e5def"},
+        {353, 42, 8, "#d53747"}, {336, 52, 8, "#eb676f"}, {208, 41, 8, "#f9b125"},
+        {321, 70, 8, "#de3646"}, {8, 60, 8, "#2a59f0"}, {180, 81, 8, "#eb9c31"},
+        {146, 65, 8, "#c41731"}, {145, 49, 8, "#d82038"}, {246, 34, 8, "#5f8af8"},
+        {169, 69, 8, "#efa11e"}, {273, 99, 8, "#2e55e2"}, {248, 120, 8, "#4167e4"},
+        {294, 41, 8, "#0b991a"}, {267, 114, 8, "#4869e3"}, {78, 67, 8, "#3059e3"},
+        {294, 23, 8, "#10a11d"}, {117, 83, 8, "#cf4055"}, {137, 80, 8, "#cd4359"},
+        {14, 71, 8, "#2855ea"}, {331, 80, 8, "#ca273c"}, {25, 82, 8, "#2650e1"},
+        {233, 46, 8, "#4a7bf9"}, {73, 13, 8, "#3d65e7"}, {327, 35, 6, "#f47875"},
+        {319, 46, 6, "#f36764"}, {256, 81, 6, "#1d4eeb"}, {244, 88, 6, "#698bf1"},
+        {194, 32, 6, "#fac652"}, {97, 56, 6, "#ee5257"}, {105, 75, 6, "#cf2a3f"},
+        {42, 4, 6, "#5681f5"}, {10, 27, 6, "#4577f6"}, {166, 55, 6, "#f7b326"},
+        {266, 88, 6, "#2b58e8"}, {178, 34, 6, "#facb5e"}, {100, 65, 6, "#e02e3d"},
+        {343, 32, 6, "#f16d6f"}, {59, 5, 6, "#507bf2"}, {27, 9, 6, "#5683f7"},
+        {233, 116, 6, "#3158e2"}, {123, 32, 6, "#f0696c"}, {6, 38, 6, "#3769f6"},
+        {63, 62, 6, "#6084ef"}, {6, 49, 6, "#2a5cf4"}, {108, 36, 6, "#f4716e"},
+        {169, 43, 6, "#f8c247"}, {137, 37, 6, "#e74653"}, {318, 58, 6, "#ec4147"},
+        {226, 100, 5, "#4876f1"}, {101, 46, 5, "#ef5c5c"}, {226, 108, 5, "#2552ea"},
+        {17, 17, 5, "#4779f7"}, {232, 93, 5, "#4b78f1"}
+    };
+}
+
+inline void computeBounds(const std::vector<PointData>& data, double& w, double& h) {
+    int minX = 99999, maxX = -99999;
+    int minY = 99999, maxY = -99999;
+    for (const auto& p : data) {
+        if (p.x < minX) minX = p.x;
+        if (p.x > maxX) maxX = p.x;
+        if (p.y < minY) minY = p.y;
+        if (p.y > maxY) maxY = p.y;
+    }
+    w = maxX - minX; h = maxY - minY;
+}
+
+// Uniform grid over the ball positions, rebuilt every tick (a counting sort,
+// so cheap). Lets the repulsion only look at balls near the cursor path.
+class SpatialGrid {
+private:
+    static const int MAX_CELLS_PER_AXIS = 256;
+
+    double cell, originX, originY;
+    int cols, rows;
+    std::vector<uint32_t> cellStart; // cols * rows + 1 offsets into items
+    std::vector<uint32_t> items;     // point indices, grouped by cell
+
+    int column(double x) const { return std::max(0, std::min(cols - 1, static_cast<int>((x - originX) / cell))); }
+    int row(double y) const { return std::max(0, std::min(rows - 1, static_cast<int>((y - originY) / cell))); }
+
+public:
+    SpatialGrid() : cell(1), originX(0), originY(0), cols(0), rows(0) {}
+
+    void build(const std::vector<Point>& points, double cellSize) {
+        cols = rows = 0;
+        if (points.empty()) return;
+
+        double minX = points[0].curPos.x, maxX = minX;
+        double minY = points[0].curPos.y, maxY = minY;
+        for (const auto& p : points) {
+            minX = std::min(minX, p.curPos.x); maxX = std::max(maxX, p.curPos.x);
+            minY = std::min(minY, p.curPos.y); maxY = std::max(maxY, p.curPos.y);
+        }
+        cell = std::max(cellSize, std::max(maxX - minX, maxY - minY) / MAX_CELLS_PER_AXIS);
+        originX = minX;
+        originY = minY;
+        cols = static_cast<int>((maxX - minX) / cell) + 1;
+        rows = static_cast<int>((maxY - minY) / cell) + 1;
+
+        cellStart.assign(static_cast<size_t>(cols) * rows + 1, 0);
+        for (const auto& p : points) cellStart[row(p.curPos.y) * cols + column(p.curPos.x) + 1]++;
+        for (size_t i = 1; i < cellStart.size(); i++) cellStart[i] += cellStart[i - 1];
+
+        items.resize(points.size());
+        std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < points.size(); i++) {
+            const Point& p = points[i];
+            items[fill[row(p.curPos.y) * cols + column(p.curPos.x)]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // Calls fn(index) for every point in a cell touching the rectangle.
+    template<typename Fn>
+    void query(double minX, double minY, double maxX, double maxY, Fn fn) const {
+        if (cols == 0) return;
+        if (maxX < originX || maxY < originY) return;
+        if (minX > originX + cols * cell || minY > originY + rows * cell) return;
+        int c0 = column(minX), c1 = column(maxX);
+        int r0 = row(minY), r1 = row(maxY);
+        for (int r = r0; r <= r1; r++) {
+            for (int c = c0; c <= c1; c++) {
+                int idx = r * cols + c;
+                for (uint32_t i = cellStart[idx]; i < cellStart[idx + 1]; i++) fn(items[i]);
+            }
+        }
+    }
+};
+
+// Something that pushes balls away: the mouse, a finger, a gamepad stick
+struct Repulsor {
+    uint32_t pointer; // InputSample::pointer
+    Vector3 pos;      // last known position
+    bool swept;       // already covered by this tick's path
+    CursorPredictor predictor;
+};
+
+class PointCollection {
+private:
+    SpatialGrid grid;
+    std::vector<double> nearestD2; // per point, squared distance to the closest path
+    std::vector<Vector3> nearest;  // per point, closest spot on any path
+
+    // Records the closest spot on segment a-b for every point near it. Long
+    // segments are queried in pieces so the grid only hands back balls that
+    // are actually close to the path.
+    void sweepSegment(const Vector3& a, const Vector3& b) {
+        double sx = b.x - a.x, sy = b.y - a.y;
+        double length = std::sqrt(sx * sx + sy * sy);
+        int pieces = std::max(1, static_cast<int>(std::ceil(length / REPULSION_RADIUS)));
+        double lengthSq = sx * sx + sy * sy;
+
+        for (int k = 0; k < pieces; k++) {
+            double t0 = static_cast<double>(k) / pieces, t1 = static_cast<double>(k + 1) / pieces;
+            double x0 = a.x + sx * t0, y0 = a.y + sy * t0;
+            double x1 = a.x + sx * t1, y1 = a.y + sy * t1;
+            grid.query(std::min(x0, x1) - REPULSION_RADIUS, std::min(y0, y1) - REPULSION_RADIUS,
+                       std::max(x0, x1) + REPULSION_RADIUS, std::max(y0, y1) + REPULSION_RADIUS,
+                       [&](uint32_t i) {
+                const Vector3& p = points[i].curPos;
+                double t = lengthSq > 0 ? ((p.x - a.x) * sx + (p.y - a.y) * sy) / lengthSq : 0;
+                t = std::max(0.0, std::min(1.0, t));
+                double cx = a.x + sx * t, cy = a.y + sy * t;
+                double d2 = (p.x - cx) * (p.x - cx) + (p.y - cy) * (p.y - cy);
+                if (d2 < nearestD2[i]) {
+                    nearestD2[i] = d2;
+                    nearest[i].set(cx, cy);
+                }
+            });
+        }
+    }
+
+    Repulsor* findRepulsor(uint32_t pointer) {
+        for (auto& r : repulsors) {
+            if (r.pointer == pointer) return &r;
+        }
+        return nullptr;
+    }
+
+public:
+    std::vector<Point> points;      // layout coordinates
+    std::vector<Repulsor> repulsors; // layout coordinates too
+    ViewTransform view;
+
+    // A resize is just this. Pointers keep their place in the window, which
+    // is somewhere else in the layout now; they're moved there without
+    // sweeping the way in between.
+    void setView(const ViewTransform& v) {
+        for (auto& r : repulsors) {
+            r.pos.set(v.layoutX(view.windowX(r.pos.x)), v.layoutY(view.windowY(r.pos.y)));
+            r.predictor = CursorPredictor();
+        }
+        view = v;
+    }
+
+    void addPoint(double x, double y, double z, double size, const std::string& color) {
+        points.emplace_back(x, y, z, size, color);
+    }
+
+    // samples are the pointer positions received since the last tick, in
+    // window coordinates, oldest first, from any number of pointers. Each ball is repelled from the
+    // closest spot on the whole path any pointer took, so a fast swipe can't
+    // skip over the logo between ticks. All paths go through one grid built
+    // for the tick, so extra fingers only cost the balls near them.
+    // With presentUs set (InputQueue::nowUs() clock), each path is extended to
+    // where its pointer is predicted to be when this tick reaches the screen.
+    // Returns false once every point has come to rest.
+    bool update(const std::vector<InputSample>& samples, uint64_t presentUs = 0) {
+        nearestD2.assign(points.size(), REPULSION_RADIUS * REPULSION_RADIUS);
+        nearest.resize(points.size());
+        if (!repulsors.empty() || !samples.empty()) grid.build(points, REPULSION_RADIUS);
+
+        for (auto& r : repulsors) r.swept = false;
+        for (const auto& s : samples) {
+            Repulsor* r = findRepulsor(s.pointer);
+            if (s.released) {
+                if (r) repulsors.erase(repulsors.begin() + (r - &repulsors[0]));
+                continue;
+            }
+            Vector3 pos(view.layoutX(s.x), view.layoutY(s.y));
+            if (!r) {
+                Repulsor added;
+                added.pointer = s.pointer;
+                added.pos = pos;
+                repulsors.push_back(added);
+                r = &repulsors.back();
+            }
+            r->predictor.addSample(pos.x, pos.y, s.timeUs);
+            sweepSegment(r->pos, pos);
+            r->pos = pos;
+            r->swept = true;
+        }
+        // With prediction on, paths reach ahead to the predicted spot; pointers
+        // that sat still this tick keep pushing from where they are
+        for (const auto& r : repulsors) {
+            Vector3 predicted;
+            if (presentUs && r.predictor.predict(presentUs, predicted.x, predicted.y)) {
+                sweepSegment(r.pos, predicted);
+            } else if (!r.swept) {
+                sweepSegment(r.pos, r.pos);
+            }
+        }
+
+        bool moving = false;
+        for (size_t i = 0; i < points.size(); i++) {
+            Point& point = points[i];
+            if (nearestD2[i] < REPULSION_RADIUS * REPULSION_RADIUS) {
+                point.targetPos.x = point.curPos.x - (nearest[i].x - point.curPos.x);
+                point.targetPos.y = point.curPos.y - (nearest[i].y - point.curPos.y);
+            } else {
+                point.targetPos.x = point.originalPos.x;
+                point.targetPos.y = point.originalPos.y;
+            }
+            point.update();
+            moving = moving || point.moved();
+        }
+        return moving;
+    }
+
+    void collectDiscs(std::vector<raster::Disc>& discs, double alpha = 1.0, double scale = 1.0) const {
+        discs.clear();
+        for (const auto& point : points) discs.push_back(point.disc(alpha, scale, view));
+    }
+
+    // Copies the ball state into out, reusing its storage
+    void snapshot(SimulationSnapshot& out) const {
+        out.view = view;
+        out.balls.resize(points.size());
+        for (size_t i = 0; i < points.size(); i++) out.balls[i] = points[i].state();
+    }
+};
+
+#endif
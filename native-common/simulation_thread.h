@@ -0,0 +1,191 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+// Runs the physics on its own thread at a fixed step, so a slow present
+// (vsync, a busy compositor) no longer holds up the simulation. After every
+// batch of ticks the ball state is copied into a triple buffer and the
+// renderer is told; it then draws the newest snapshot whenever it gets to it.
+// The thread sleeps while everything is at rest and nothing is queued.
+//
+// The PointCollection belongs to this thread once start() is called. Anything
+// else that needs to change it (a resize recentring the logo) goes through
+// post().
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "input_queue.h"
+#include "simulation.h"
+#include "triple_buffer.h"
+
+class SimulationThread {
+public:
+    typedef InputQueue<1024> Input;
+    typedef std::function<void(PointCollection&)> Command;
+
+private:
+    static const int MAX_CATCH_UP = 8; // ticks run at once after a stall
+    enum { INPUT_HISTORY = 16 };
+
+    PointCollection& points;
+    Input& input;
+    const uint64_t stepUs;
+    std::function<void()> published;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool quitting;
+    bool wakeRequested; // input or a command arrived since the last tick
+    std::vector<Command> commands;
+
+    TripleBuffer<SimulationSnapshot> snapshots;
+    uint64_t sequence;
+    std::atomic<uint64_t> aheadUs;
+    std::vector<InputSample> samples;
+
+    // Oldest input each snapshot reacted to (0 for none), by sequence, so the
+    // renderer can account for input in snapshots it never got to draw
+    std::atomic<uint64_t> inputUs[INPUT_HISTORY];
+    uint64_t lastAcquired; // consumer owned
+
+    static std::chrono::steady_clock::time_point timePoint(uint64_t us) {
+        return std::chrono::steady_clock::time_point(std::chrono::microseconds(us));
+    }
+
+    void publish(bool moving, uint64_t oldestInputUs) {
+        SimulationSnapshot& s = snapshots.write();
+        points.snapshot(s);
+        s.sequence = ++sequence;
+        s.tickUs = Input::nowUs();
+        s.moving = moving;
+        inputUs[sequence % INPUT_HISTORY].store(oldestInputUs, std::memory_order_relaxed);
+        snapshots.publish();
+        if (published) published();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t nextUs = Input::nowUs();
+        bool sleeping = false;
+
+        while (!quitting) {
+            if (sleeping) {
+                wakeup.wait(lock, [this] { return quitting || wakeRequested; });
+                if (quitting) break;
+                // Waking up reacts straight away rather than a step later
+                sleeping = false;
+                nextUs = Input::nowUs();
+            }
+            if (wakeup.wait_until(lock, timePoint(nextUs), [this] { return quitting; })) break;
+
+            std::vector<Command> pending;
+            pending.swap(commands);
+            wakeRequested = false;
+            lock.unlock();
+
+            for (auto& command : pending) command(points);
+
+            uint64_t now = Input::nowUs();
+            int ticks = static_cast<int>(std::min<uint64_t>((now - nextUs) / stepUs + 1, MAX_CATCH_UP));
+            nextUs += ticks * stepUs;
+            // Past the catch-up limit the missed ticks are dropped
+            if (nextUs <= now) nextUs = now + stepUs;
+
+            samples.clear();
+            input.popAll(samples);
+            uint64_t oldestInputUs = samples.empty() ? 0 : samples.front().timeUs;
+            uint64_t ahead = aheadUs.load(std::memory_order_relaxed);
+            uint64_t presentUs = ahead ? now + ahead : 0;
+            bool moving = false;
+            for (int i = 0; i < ticks; i++) {
+                moving = points.update(samples, presentUs) || moving;
+                samples.clear();
+            }
+            publish(moving, oldestInputUs);
+
+            lock.lock();
+            // Nothing moved and no input since the tick: sleep until some arrives
+            if (!moving && !wakeRequested) sleeping = true;
+        }
+    }
+
+public:
+    SimulationThread(PointCollection& points, Input& input, uint64_t stepUs)
+        : points(points), input(input), stepUs(stepUs), quitting(false), wakeRequested(false),
+          sequence(0), aheadUs(0), lastAcquired(0) {
+        for (auto& us : inputUs) us.store(0, std::memory_order_relaxed);
+    }
+
+    ~SimulationThread() { stop(); }
+
+    // published is called on the simulation thread after each new snapshot,
+    // to wake up the renderer. The current state is published before the
+    // thread starts, so there is something to draw straight away.
+    void start(std::function<void()> onPublished) {
+        published = onPublished;
+        publish(false, 0);
+        quitting = false;
+        thread = std::thread(&SimulationThread::run, this);
+    }
+
+    void stop() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wakeup.notify_one();
+        thread.join();
+    }
+
+    // Call after queueing input so a resting simulation picks it up
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wakeRequested = true;
+        }
+        wakeup.notify_one();
+    }
+
+    // Runs fn on the simulation thread before its next tick
+    void post(const Command& fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            commands.push_back(fn);
+            wakeRequested = true;
+        }
+        wakeup.notify_one();
+    }
+
+    // How far past the tick pointers are extrapolated, see
+    // PointCollection::update(). 0 turns prediction off.
+    void setPredictionAhead(uint64_t us) { aheadUs.store(us, std::memory_order_relaxed); }
+
+    // Renderer side: brings the newest snapshot to snapshot(). Returns false
+    // when there is nothing new. inputUs is the oldest input it (or any
+    // snapshot skipped since the last acquire) reacted to, 0 for none.
+    bool acquire(uint64_t& oldestInputUs) {
+        oldestInputUs = 0;
+        if (!snapshots.update()) return false;
+        uint64_t seq = snapshots.read().sequence;
+        uint64_t first = std::max(lastAcquired + 1, seq >= INPUT_HISTORY ? seq - INPUT_HISTORY + 1 : 1);
+        for (uint64_t i = first; i <= seq; i++) {
+            uint64_t us = inputUs[i % INPUT_HISTORY].load(std::memory_order_relaxed);
+            if (us && (!oldestInputUs || us < oldestInputUs)) oldestInputUs = us;
+        }
+        lastAcquired = seq;
+        return true;
+    }
+
+    const SimulationSnapshot& snapshot() const { return snapshots.read(); }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef TILED_RASTER_H
+#define TILED_RASTER_H
+
+// Parallel front end for raster.h. Discs are binned into fixed screen tiles
+// and every tile is cleared and drawn start to finish by a single thread, so
+// workers never touch the same pixels and need no locking while they draw.
+// Threads only meet at the start and end of a frame.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "raster.h"
+
+class TiledRasterizer {
+public:
+    enum { TILE_WIDTH = 256, TILE_HEIGHT = 32 };
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    uint64_t generation;
+    unsigned busy;
+    bool quitting;
+    std::atomic<int> nextTile;
+
+    // Current frame, written before the workers are woken
+    raster::Target target;
+    uint32_t background;
+    const std::vector<raster::Disc>* discs;
+    int tilesX, tilesY;
+    std::vector<std::vector<uint32_t> > bins;
+
+    void bin() {
+        tilesX = (target.width + TILE_WIDTH - 1) / TILE_WIDTH;
+        tilesY = (target.height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        size_t count = static_cast<size_t>(tilesX) * tilesY;
+        if (bins.size() < count) bins.resize(count);
+        for (size_t i = 0; i < count; i++) bins[i].clear();
+
+        // Draw order within a tile follows the disc order
+        for (size_t i = 0; i < discs->size(); i++) {
+            const raster::Disc& d = (*discs)[i];
+            float reach = d.r + 1.0f;
+            if (d.x + reach < 0 || d.y + reach < 0) continue;
+            int x0 = std::max(0, static_cast<int>(std::floor(d.x - reach)) / TILE_WIDTH);
+            int x1 = std::min(tilesX - 1, static_cast<int>(std::ceil(d.x + reach)) / TILE_WIDTH);
+            int y0 = std::max(0, static_cast<int>(std::floor(d.y - reach)) / TILE_HEIGHT);
+            int y1 = std::min(tilesY - 1, static_cast<int>(std::ceil(d.y + reach)) / TILE_HEIGHT);
+            for (int ty = y0; ty <= y1; ty++) {
+                for (int tx = x0; tx <= x1; tx++) bins[ty * tilesX + tx].push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+    void drawTile(int tile) {
+        int ox = (tile % tilesX) * TILE_WIDTH;
+        int oy = (tile / tilesX) * TILE_HEIGHT;
+        raster::Target sub;
+        sub.pixels = target.pixels + static_cast<size_t>(oy) * target.stride + ox;
+        sub.stride = target.stride;
+        sub.width = std::min(static_cast<int>(TILE_WIDTH), target.width - ox);
+        sub.height = std::min(static_cast<int>(TILE_HEIGHT), target.height - oy);
+
+        raster::fill(sub, background);
+        const std::vector<uint32_t>& list = bins[tile];
+        for (size_t i = 0; i < list.size(); i++) {
+            raster::Disc d = (*discs)[list[i]];
+            d.x -= ox;
+            d.y -= oy;
+            raster::drawDisc(sub, d);
+        }
+    }
+
+    void drawTiles() {
+        int count = tilesX * tilesY;
+        for (;;) {
+            int tile = nextTile.fetch_add(1);
+            if (tile >= count) return;
+            drawTile(tile);
+        }
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return quitting || generation != seen; });
+                if (quitting) return;
+                seen = generation;
+            }
+            drawTiles();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy == 0) finished.notify_one();
+            }
+        }
+    }
+
+public:
+    // threads == 0 uses every core. The calling thread always draws too.
+    explicit TiledRasterizer(unsigned threads = 0)
+        : generation(0), busy(0), quitting(false), nextTile(0), background(0xFFFFFFFF),
+          discs(nullptr), tilesX(0), tilesY(0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 1; i < threads; i++) workers.push_back(std::thread(&TiledRasterizer::workerLoop, this));
+    }
+
+    ~TiledRasterizer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    unsigned threadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Clears the whole target to bg and draws the discs in order.
+    void render(const raster::Target& t, uint32_t bg, const std::vector<raster::Disc>& list) {
+        if (t.width <= 0 || t.height <= 0) return;
+        target = t;
+        background = bg;
+        discs = &list;
+        bin();
+        nextTile = 0;
+
+        if (workers.empty()) {
+            drawTiles();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+            busy = static_cast<unsigned>(workers.size());
+        }
+        wake.notify_all();
+        drawTiles();
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return busy == 0; });
+    }
+};
+
+#endif
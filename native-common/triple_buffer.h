@@ -0,0 +1,46 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+// Hands the newest value from one thread to another without either side ever
+// waiting. The producer fills its back slot and swaps it with the middle one;
+// the consumer swaps the middle slot for its front one whenever something new
+// is there. Values the consumer was too slow to pick up are simply replaced,
+// so it always reads the latest complete one.
+
+#include <atomic>
+
+template<typename T>
+class TripleBuffer {
+private:
+    enum { INDEX = 3, FRESH = 4 }; // middle holds a slot index plus a "not read yet" bit
+
+    T slots[3];
+    unsigned back;                // producer owned
+    alignas(64) std::atomic<unsigned> middle;
+    alignas(64) unsigned front;   // consumer owned
+
+public:
+    TripleBuffer() : back(0), middle(1), front(2) {}
+
+    // Producer side: fill this, then publish() it. Slots are reused, so
+    // containers in T keep their capacity from two publishes ago.
+    T& write() { return slots[back]; }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side: moves the newest published value to the front. Returns
+    // false when there was nothing new since the last call.
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // Whatever update() last brought to the front; default constructed until
+    // the first publish
+    const T& read() const { return slots[front]; }
+};
+
+#endif
@@ -0,0 +1,478 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <libinput.h>
+#include <libudev.h>
+#include <linux/input-event-codes.h>
+#include <vector>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#include "../native-common/latency.h"
+#include "../native-common/tiled_raster.h"
+#include "../native-common/simulation_thread.h"
+
+// Straight to the display controller, no compositor: the balls go into dumb
+// buffers (plain CPU-mapped memory the kernel can scan out) and are shown by
+// page flipping between two of them. The flip happens at vblank and the
+// kernel tells us through an event on the card fd, which is what paces the
+// frames.
+
+static int drm_fd = -1;
+static uint32_t connector_id, crtc_id;
+static drmModeModeInfo mode;
+static drmModeCrtc *saved_crtc; // put back on exit, so the console comes back
+
+static int width = 0, height = 0;
+static bool running = true;
+
+struct DumbBuffer {
+    uint32_t handle;
+    uint32_t fb;
+    uint32_t pitch;
+    uint64_t size;
+    uint32_t *pixels;
+};
+static DumbBuffer buffers[2];
+static int front = 0;          // the one being scanned out
+static bool flip_pending = false;
+
+// libinput reads every pointer, touchscreen and keyboard on the seat
+static struct udev *udev;
+static struct libinput *input;
+static double cursor_x, cursor_y;
+static bool cursor_shown = false; // only once a mouse has moved
+
+// libinput callbacks queue every sample; the physics tick drains them.
+// Pointer 0 is the mouse, touch slots follow.
+static InputQueue<1024> inputQueue;
+
+// Physics runs on its own thread, which sleeps while everything is at rest.
+// Each tick it publishes a snapshot and bumps sim_fd; frames draw the newest.
+static const int physics_step_ms = 30;
+static SimulationThread *simulation;
+static int sim_fd = -1;
+static uint64_t last_tick_us = 0;
+static bool animating = false;
+static bool redraw_needed = true;
+
+// With --latency, input-to-photon percentiles are printed on exit. A frame
+// counts as on screen when its page flip completes.
+static bool report_latency = false;
+static InputLatency latency;
+
+static PointCollection pointCollection; // owned by the simulation thread
+static TiledRasterizer *rasterizer;
+static std::vector<raster::Disc> discs;
+
+static uint64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void wake_physics() {
+    simulation->wake();
+}
+
+static bool create_buffer(DumbBuffer& buffer) {
+    struct drm_mode_create_dumb create;
+    memset(&create, 0, sizeof(create));
+    create.width = width;
+    create.height = height;
+    create.bpp = 32;
+    if (drmIoctl(drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0) {
+        fprintf(stderr, "Creating a dumb buffer failed: %m\n");
+        return false;
+    }
+    buffer.handle = create.handle;
+    buffer.pitch = create.pitch;
+    buffer.size = create.size;
+
+    // XRGB8888, which is what the rasterizer writes
+    if (drmModeAddFB(drm_fd, width, height, 24, 32, buffer.pitch, buffer.handle, &buffer.fb) < 0) {
+        fprintf(stderr, "Adding a framebuffer failed: %m\n");
+        return false;
+    }
+
+    struct drm_mode_map_dumb map;
+    memset(&map, 0, sizeof(map));
+    map.handle = buffer.handle;
+    if (drmIoctl(drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &map) < 0) {
+        fprintf(stderr, "Mapping a dumb buffer failed: %m\n");
+        return false;
+    }
+    void *data = mmap(NULL, buffer.size, PROT_READ | PROT_WRITE, MAP_SHARED, drm_fd, map.offset);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "mmap failed: %m\n");
+        return false;
+    }
+    buffer.pixels = (uint32_t*)data;
+    return true;
+}
+
+static void destroy_buffer(DumbBuffer& buffer) {
+    if (buffer.pixels) munmap(buffer.pixels, buffer.size);
+    if (buffer.fb) drmModeRmFB(drm_fd, buffer.fb);
+    if (buffer.handle) {
+        struct drm_mode_destroy_dumb destroy;
+        memset(&destroy, 0, sizeof(destroy));
+        destroy.handle = buffer.handle;
+        drmIoctl(drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy);
+    }
+    memset(&buffer, 0, sizeof(buffer));
+}
+
+// Whether a connector other than this one is being driven by the CRTC
+static bool crtc_in_use(drmModeRes *resources, uint32_t crtc, uint32_t connector_id) {
+    bool used = false;
+    for (int i = 0; i < resources->count_connectors && !used; i++) {
+        if (resources->connectors[i] == connector_id) continue;
+        drmModeConnector *other = drmModeGetConnector(drm_fd, resources->connectors[i]);
+        if (!other) continue;
+        if (other->encoder_id) {
+            drmModeEncoder *encoder = drmModeGetEncoder(drm_fd, other->encoder_id);
+            if (encoder) {
+                used = encoder->crtc_id == crtc;
+                drmModeFreeEncoder(encoder);
+            }
+        }
+        drmModeFreeConnector(other);
+    }
+    return used;
+}
+
+// The CRTC already driving the connector, or else one its encoders can drive
+// that no other connector is using
+static uint32_t find_crtc(drmModeRes *resources, drmModeConnector *connector) {
+    if (connector->encoder_id) {
+        drmModeEncoder *encoder = drmModeGetEncoder(drm_fd, connector->encoder_id);
+        if (encoder) {
+            uint32_t crtc = encoder->crtc_id;
+            drmModeFreeEncoder(encoder);
+            if (crtc) return crtc;
+        }
+    }
+    for (int i = 0; i < connector->count_encoders; i++) {
+        drmModeEncoder *encoder = drmModeGetEncoder(drm_fd, connector->encoders[i]);
+        if (!encoder) continue;
+        for (int j = 0; j < resources->count_crtcs; j++) {
+            if ((encoder->possible_crtcs & (1u << j)) &&
+                !crtc_in_use(resources, resources->crtcs[j], connector->connector_id)) {
+                drmModeFreeEncoder(encoder);
+                return resources->crtcs[j];
+            }
+        }
+        drmModeFreeEncoder(encoder);
+    }
+    return 0;
+}
+
+// First connected output, at its preferred mode
+static bool find_output() {
+    drmModeRes *resources = drmModeGetResources(drm_fd);
+    if (!resources) return false;
+    bool found = false;
+    for (int i = 0; i < resources->count_connectors && !found; i++) {
+        drmModeConnector *connector = drmModeGetConnector(drm_fd, resources->connectors[i]);
+        if (!connector) continue;
+        if (connector->connection == DRM_MODE_CONNECTED && connector->count_modes > 0) {
+            uint32_t crtc = find_crtc(resources, connector);
+            if (crtc) {
+                mode = connector->modes[0];
+                for (int m = 0; m < connector->count_modes; m++) {
+                    if (connector->modes[m].type & DRM_MODE_TYPE_PREFERRED) {
+                        mode = connector->modes[m];
+                        break;
+                    }
+                }
+                connector_id = connector->connector_id;
+                crtc_id = crtc;
+                found = true;
+            }
+        }
+        drmModeFreeConnector(connector);
+    }
+    drmModeFreeResources(resources);
+    return found;
+}
+
+static bool open_card(const char *path) {
+    drm_fd = open(path, O_RDWR | O_CLOEXEC);
+    if (drm_fd < 0) return false;
+    uint64_t has_dumb = 0;
+    if (drmGetCap(drm_fd, DRM_CAP_DUMB_BUFFER, &has_dumb) == 0 && has_dumb && find_output()) return true;
+    close(drm_fd);
+    drm_fd = -1;
+    return false;
+}
+
+static void initPoints() {
+    std::vector<PointData> pointData = logoPoints();
+
+    double logo_width, logo_height;
+    computeBounds(pointData, logo_width, logo_height);
+    ViewTransform view = ViewTransform::centered(logo_width, logo_height, width, height);
+
+    // The points are built on the thread that owns them, in logo coordinates
+    simulation->post([pointData, view](PointCollection& points) {
+        points.points.clear();
+        for (const auto& data : pointData) {
+            points.addPoint(data.x, data.y, 0.0, static_cast<double>(data.size), data.color);
+        }
+        points.setView(view);
+    });
+}
+
+static int open_restricted(const char *path, int flags, void *user_data) {
+    int fd = open(path, flags | O_CLOEXEC);
+    return fd < 0 ? -errno : fd;
+}
+static void close_restricted(int fd, void *user_data) { close(fd); }
+static const struct libinput_interface input_interface = { open_restricted, close_restricted };
+
+static uint32_t touch_pointer(struct libinput_event_touch *touch) {
+    return 1 + static_cast<uint32_t>(libinput_event_touch_get_seat_slot(touch)) % 63;
+}
+
+static void handle_input() {
+    libinput_dispatch(input);
+    struct libinput_event *event;
+    while ((event = libinput_get_event(input))) {
+        switch (libinput_event_get_type(event)) {
+        case LIBINPUT_EVENT_POINTER_MOTION: {
+            struct libinput_event_pointer *pointer = libinput_event_get_pointer_event(event);
+            cursor_x = std::min(std::max(cursor_x + libinput_event_pointer_get_dx(pointer), 0.0), width - 1.0);
+            cursor_y = std::min(std::max(cursor_y + libinput_event_pointer_get_dy(pointer), 0.0), height - 1.0);
+            cursor_shown = true;
+            inputQueue.push(cursor_x, cursor_y, 0);
+            wake_physics();
+            redraw_needed = true;
+            break;
+        }
+        case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE: {
+            struct libinput_event_pointer *pointer = libinput_event_get_pointer_event(event);
+            cursor_x = libinput_event_pointer_get_absolute_x_transformed(pointer, width);
+            cursor_y = libinput_event_pointer_get_absolute_y_transformed(pointer, height);
+            cursor_shown = true;
+            inputQueue.push(cursor_x, cursor_y, 0);
+            wake_physics();
+            redraw_needed = true;
+            break;
+        }
+        case LIBINPUT_EVENT_TOUCH_DOWN:
+        case LIBINPUT_EVENT_TOUCH_MOTION: {
+            struct libinput_event_touch *touch = libinput_event_get_touch_event(event);
+            inputQueue.push(libinput_event_touch_get_x_transformed(touch, width),
+                            libinput_event_touch_get_y_transformed(touch, height), touch_pointer(touch));
+            wake_physics();
+            break;
+        }
+        case LIBINPUT_EVENT_TOUCH_UP: {
+            inputQueue.release(touch_pointer(libinput_event_get_touch_event(event)));
+            wake_physics();
+            break;
+        }
+        case LIBINPUT_EVENT_KEYBOARD_KEY: {
+            // No window to close, so Esc or Q quits
+            struct libinput_event_keyboard *key = libinput_event_get_keyboard_event(event);
+            uint32_t code = libinput_event_keyboard_get_key(key);
+            if (libinput_event_keyboard_get_key_state(key) == LIBINPUT_KEY_STATE_PRESSED && (code == KEY_ESC || code == KEY_Q)) {
+                running = false;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        libinput_event_destroy(event);
+    }
+}
+
+static void draw_frame() {
+    uint64_t frame_start = get_time_us();
+
+    double alpha = 1.0;
+    if (animating) alpha = std::min(1.0, (double)(frame_start - last_tick_us) / (physics_step_ms * 1000.0));
+
+    // Both buffers get drawn in full: the one we draw into holds the frame
+    // before last, so patching it up would need twice the damage
+    DumbBuffer& back = buffers[front ^ 1];
+    raster::Target target = { back.pixels, (int)(back.pitch / 4), width, height };
+    simulation->snapshot().collectDiscs(discs, alpha, 1.0);
+    // No compositor means no cursor either, so it's drawn with the balls
+    if (cursor_shown) {
+        raster::Disc cursor = { (float)cursor_x, (float)cursor_y, 4.0f, 0xFF404040 };
+        discs.push_back(cursor);
+    }
+    rasterizer->render(target, 0xFFFFFFFF, discs);
+
+    if (drmModePageFlip(drm_fd, crtc_id, back.fb, DRM_MODE_PAGE_FLIP_EVENT, NULL) < 0) {
+        fprintf(stderr, "Page flip failed: %m\n");
+        running = false;
+        return;
+    }
+    flip_pending = true;
+    latency.frameSubmitted();
+    redraw_needed = false;
+}
+
+static void page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec, void *user_data) {
+    flip_pending = false;
+    front ^= 1;
+    // Flip timestamps are CLOCK_MONOTONIC, like InputLatency::nowUs()
+    latency.presented((uint64_t)tv_sec * 1000000 + tv_usec);
+    // Interpolate towards the next tick on every vblank while moving
+    if (animating) redraw_needed = true;
+}
+
+int main(int argc, char **argv) {
+    const char *device = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--device=", 9) == 0) {
+            device = argv[i] + 9;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            report_latency = true;
+        } else {
+            fprintf(stderr, "usage: %s [--device=/dev/dri/cardN] [--latency]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Signals are read from a signalfd in the main loop. They have to be
+    // blocked before any thread exists, which includes the rasterizer's.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    sim_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (signal_fd < 0 || sim_fd < 0) { fprintf(stderr, "Failed to create signal or event fd: %m\n"); return 1; }
+
+    if (device) {
+        if (!open_card(device)) { fprintf(stderr, "No connected output with dumb buffers on %s\n", device); return 1; }
+    } else {
+        for (int i = 0; i < 8 && drm_fd < 0; i++) {
+            char path[32];
+            snprintf(path, sizeof(path), "/dev/dri/card%d", i);
+            open_card(path);
+        }
+        if (drm_fd < 0) { fprintf(stderr, "No DRM card with a connected output found\n"); return 1; }
+    }
+    width = mode.hdisplay;
+    height = mode.vdisplay;
+    cursor_x = width / 2.0;
+    cursor_y = height / 2.0;
+
+    if (!create_buffer(buffers[0]) || !create_buffer(buffers[1])) return 1;
+    raster::Target first = { buffers[0].pixels, (int)(buffers[0].pitch / 4), width, height };
+    raster::fill(first, 0xFFFFFFFF);
+
+    saved_crtc = drmModeGetCrtc(drm_fd, crtc_id);
+    if (drmModeSetCrtc(drm_fd, crtc_id, buffers[0].fb, 0, 0, &connector_id, 1, &mode) < 0) {
+        // EACCES when something else (a compositor, X) is DRM master
+        fprintf(stderr, "Setting the mode failed: %m. Run it from a text console with nothing else on the display\n");
+        return 1;
+    }
+
+    udev = udev_new();
+    input = udev ? libinput_udev_create_context(&input_interface, NULL, udev) : NULL;
+    if (!input || libinput_udev_assign_seat(input, "seat0") < 0) {
+        fprintf(stderr, "No input devices, the balls will only sit there\n");
+        if (input) libinput_unref(input);
+        input = NULL;
+    }
+
+    TiledRasterizer frame_rasterizer;
+    rasterizer = &frame_rasterizer;
+
+    SimulationThread physics(pointCollection, inputQueue, physics_step_ms * 1000);
+    simulation = &physics;
+    physics.start([]() {
+        // Can only fail once the counter is saturated, and then it's set anyway
+        uint64_t one = 1;
+        ssize_t written = write(sim_fd, &one, sizeof(one));
+        (void)written;
+    });
+    initPoints();
+
+    drmEventContext events;
+    memset(&events, 0, sizeof(events));
+    events.version = 2;
+    events.page_flip_handler = page_flip_handler;
+
+    struct pollfd fds[4];
+    fds[0].fd = drm_fd;
+    fds[1].fd = sim_fd;
+    fds[2].fd = signal_fd;
+    fds[3].fd = input ? libinput_get_fd(input) : -1;
+    fds[0].events = fds[1].events = fds[2].events = fds[3].events = POLLIN;
+
+    wake_physics();
+
+    while (running) {
+        if (redraw_needed && !flip_pending) draw_frame();
+
+        if (poll(fds, 4, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) drmHandleEvent(drm_fd, &events);
+        if (fds[3].revents & POLLIN) handle_input();
+
+        if (fds[2].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) running = false;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t ticks;
+            uint64_t input_us;
+            if (read(sim_fd, &ticks, sizeof(ticks)) == sizeof(ticks) && simulation->acquire(input_us)) {
+                if (input_us) latency.consumed(input_us);
+                // steady_clock is CLOCK_MONOTONIC here, like get_time_us()
+                last_tick_us = simulation->snapshot().tickUs;
+                animating = simulation->snapshot().moving;
+                redraw_needed = true;
+            }
+        }
+    }
+
+    physics.stop();
+    // A flip still in flight has to land before its buffer goes away
+    while (flip_pending) {
+        struct pollfd drm_poll = { drm_fd, POLLIN, 0 };
+        if (poll(&drm_poll, 1, 100) <= 0) break;
+        drmHandleEvent(drm_fd, &events);
+    }
+    if (saved_crtc) {
+        drmModeSetCrtc(drm_fd, saved_crtc->crtc_id, saved_crtc->buffer_id, saved_crtc->x, saved_crtc->y,
+                       &connector_id, 1, &saved_crtc->mode);
+        drmModeFreeCrtc(saved_crtc);
+    }
+    destroy_buffer(buffers[0]);
+    destroy_buffer(buffers[1]);
+    if (input) libinput_unref(input);
+    if (udev) udev_unref(udev);
+    close(drm_fd);
+    close(sim_fd);
+    close(signal_fd);
+    if (report_latency) latency.print(stdout);
+
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <stdalign.h>
 #include "icon/balls.h"
 
 typedef struct {
@@ -16,23 +18,79 @@ typedef struct {
 
 typedef struct {
     Vector3 curPos, originalPos, targetPos, velocity;
+    Vector3 prevPos;   // curPos before the last physics step
+    Vector3 drawPos;   // where frames draw it, between prevPos and curPos
     Color color;
     double radius, size;
+    double prevRadius, drawRadius;
     double friction;
     double springStrength;
+    Vector3 nearest;   // closest spot on this step's cursor path
+    double nearestD2;  // squared distance to it
 } Point;
 
+// Balls live in the logo's own coordinates; this puts the logo in the
+// widget: widget = layout * scale + offset. A resize only moves the offset,
+// so balls in flight carry on from where they were.
 typedef struct {
-    Vector3 mousePos;
+    double offsetX, offsetY, scale;
+} ViewTransform;
+
+typedef struct {
+    Vector3 mousePos; // layout coordinates
     Point* points;
     size_t count;
+    ViewTransform view;
 } PointCollection;
 
+// Pointer samples handed from the motion callback to the simulation tick.
+// Single producer, single consumer, lock-free: each side owns one index and
+// publishes a slot with a release store, so either side can move to another
+// thread without changing the protocol.
+#define INPUT_QUEUE_SIZE 1024u
+
+typedef struct {
+    double x, y;
+    gint64 time_us; // g_get_monotonic_time() when the sample arrived, the frame clock's clock
+} InputSample;
+
+typedef struct {
+    alignas(64) atomic_size_t head; // next slot to read, consumer owned
+    alignas(64) atomic_size_t tail; // next slot to write, producer owned
+    InputSample slots[INPUT_QUEUE_SIZE];
+} InputQueue;
+
+// Pre-rendered discs, so a frame is a stack of image blits instead of
+// tessellating and rasterizing every circle again. Entries are keyed by
+// colour, radius in quarter pixels and which quarter of a pixel the centre
+// falls in; the least recently drawn ones go once the cache is full.
+#define DISC_SUBPIXEL 4u
+#define DISC_CACHE_CAPACITY 4096u
+
+typedef struct {
+    gint64 key;               // also the hash table key, see disc_cache_key()
+    cairo_surface_t* surface;
+    int pad;                  // device pixels from the surface origin to the centre's pixel
+    GList link;               // node in the LRU queue, most recent at the head
+} DiscEntry;
+
+typedef struct {
+    GHashTable* entries;      // &DiscEntry::key -> DiscEntry*, owns the entries
+    GQueue lru;
+    int scale;                // device scale the surfaces were rendered for
+} DiscCache;
+
 typedef struct {
     GtkWidget* window;
     GtkWidget* drawing_area;
     PointCollection pc;
+    InputQueue input;
+    DiscCache discs;
     gboolean running;
+    guint tick_id;           // frame clock tick callback, 0 while at rest
+    gint64 last_frame_us;    // frame clock time of the previous tick, 0 right after waking
+    gint64 accumulator_us;   // frame time not yet consumed by physics steps
+    gboolean moving;         // anything moved (or the cursor did) on the last step
     int width;
     int height;
 } App;
@@ -45,6 +103,13 @@ typedef struct {
 
 static const double PI = 3.14159265359; // why not just pi :sob: (and then just multiply it)
 
+// The physics constants are tuned for this step; frames run as many steps as
+// frame clock time has passed, up to a few after a stall
+static const gint64 PHYSICS_STEP_US = 30000;
+static const gint64 MAX_STEPS_PER_FRAME = 4;
+
+static const double REPULSION_RADIUS = 150.0;
+
 static const PointData pointData[] = {
     {202, 78, 9, "#ed9d33"}, {348, 83, 9, "#d44d61"}, {256, 69, 9, "#4f7af2"},
     {214, 59, 9, "#ef9a1e"}, {265, 36, 9, "#4976f3"}, {300, 78, 9, "#269230"},
@@ -104,8 +169,51 @@ static Color color_from_hex(const char* hex) {
     return c;
 }
 
+// Input queue
+static void input_queue_init(InputQueue* q) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+// Producer side. A full queue means the consumer stopped draining; the new
+// sample is dropped rather than blocking the UI thread.
+static bool input_queue_push(InputQueue* q, double x, double y) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (tail - head == INPUT_QUEUE_SIZE) return false;
+
+    InputSample* s = &q->slots[tail & (INPUT_QUEUE_SIZE - 1)];
+    s->x = x;
+    s->y = y;
+    s->time_us = g_get_monotonic_time();
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Consumer side: the oldest sample, left in the queue
+static bool input_queue_peek(InputQueue* q, InputSample* out) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head == tail) return false;
+
+    *out = q->slots[head & (INPUT_QUEUE_SIZE - 1)];
+    return true;
+}
+
+// Consumer side, oldest sample first.
+static bool input_queue_pop(InputQueue* q, InputSample* out) {
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head == tail) return false;
+
+    *out = q->slots[head & (INPUT_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
 // Physics and rendering
-static void point_update(Point* p) {
+// Returns whether the point is still in motion
+static bool point_update(Point* p) {
     // X axis spring physics
     double dx = p->targetPos.x - p->curPos.x;
     double ax = dx * p->springStrength;
@@ -154,39 +262,225 @@ static void point_update(Point* p) {
     // Update radius based on depth
     p->radius = p->size * p->curPos.z;
     if (p->radius < 1.0) p->radius = 1.0;
+
+    return p->velocity.x != 0.0 || p->velocity.y != 0.0 || p->velocity.z != 0.0;
+}
+
+// Disc cache
+static void disc_entry_free(gpointer data) {
+    DiscEntry* e = (DiscEntry*)data;
+    cairo_surface_destroy(e->surface);
+    g_free(e);
+}
+
+static void disc_cache_init(DiscCache* cache) {
+    cache->entries = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, disc_entry_free);
+    g_queue_init(&cache->lru);
+    cache->scale = 1;
+}
+
+static void disc_cache_clear(DiscCache* cache) {
+    g_queue_init(&cache->lru);
+    g_hash_table_remove_all(cache->entries);
+}
+
+static void disc_cache_free(DiscCache* cache) {
+    if (!cache->entries) return;
+    g_queue_init(&cache->lru);
+    g_hash_table_destroy(cache->entries);
+    cache->entries = NULL;
+}
+
+static guint64 color_channel(double c) {
+    return (guint64)lround(fmin(fmax(c, 0.0), 1.0) * 255.0);
+}
+
+// RGBA in bits 20-51, then 16 bits of radius and 2 + 2 of sub-pixel bucket
+static gint64 disc_cache_key(const Color* c, guint radius_q, guint bx, guint by) {
+    guint64 rgba = (color_channel(c->r) << 24) | (color_channel(c->g) << 16) |
+                   (color_channel(c->b) << 8) | color_channel(c->a);
+    guint64 key = (rgba << 20) | ((guint64)radius_q << 4) | ((guint64)bx << 2) | (guint64)by;
+    return (gint64)key;
+}
+
+// A disc of radius_q / 4 device pixels centred (bx + 0.5, by + 0.5) /
+// DISC_SUBPIXEL into pixel (pad, pad) of its surface
+static DiscEntry* disc_cache_get(DiscCache* cache, const Color* c, guint radius_q, guint bx, guint by) {
+    gint64 key = disc_cache_key(c, radius_q, bx, by);
+    DiscEntry* e = (DiscEntry*)g_hash_table_lookup(cache->entries, &key);
+    if (e) {
+        g_queue_unlink(&cache->lru, &e->link);
+        g_queue_push_head_link(&cache->lru, &e->link);
+        return e;
+    }
+
+    double r = radius_q / 4.0;
+    int pad = (int)ceil(r) + 1;
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, pad * 2, pad * 2);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    cairo_t* dc = cairo_create(surface);
+    cairo_set_antialias(dc, CAIRO_ANTIALIAS_BEST);
+    cairo_set_source_rgba(dc, c->r, c->g, c->b, c->a);
+    cairo_arc(dc, pad + (bx + 0.5) / DISC_SUBPIXEL, pad + (by + 0.5) / DISC_SUBPIXEL, r, 0, PI*2);
+    cairo_fill(dc);
+    cairo_destroy(dc);
+    cairo_surface_set_device_scale(surface, cache->scale, cache->scale);
+
+    if (g_hash_table_size(cache->entries) >= DISC_CACHE_CAPACITY) {
+        GList* stale = g_queue_pop_tail_link(&cache->lru);
+        if (stale) g_hash_table_remove(cache->entries, &((DiscEntry*)stale->data)->key);
+    }
+
+    e = g_new0(DiscEntry, 1);
+    e->key = key;
+    e->surface = surface;
+    e->pad = pad;
+    e->link.data = e;
+    g_hash_table_insert(cache->entries, &e->key, e);
+    g_queue_push_head_link(&cache->lru, &e->link);
+    return e;
+}
+
+static double view_x(const ViewTransform* view, double x) { return x * view->scale + view->offsetX; }
+static double view_y(const ViewTransform* view, double y) { return y * view->scale + view->offsetY; }
+
+// Puts the logo in the middle of a width x height widget, at its own size
+static ViewTransform view_centered(int width, int height) {
+    double logoW, logoH;
+    compute_pointdata_bounds(&logoW, &logoH);
+    ViewTransform view = { (width / 2.0) - (logoW / 2.0), (height / 2.0) - (logoH / 2.0), 1.0 };
+    return view;
+}
+
+static void point_draw(Point* p, cairo_t* cr, DiscCache* cache, const ViewTransform* view) {
+    // Split the centre into a device pixel and a sub-pixel bucket within it
+    double scale = cache->scale;
+    double x = view_x(view, p->drawPos.x);
+    double y = view_y(view, p->drawPos.y);
+    double radius = p->drawRadius * view->scale;
+    double dx = x * scale;
+    double dy = y * scale;
+    double ix = floor(dx);
+    double iy = floor(dy);
+    guint bx = (guint)((dx - ix) * DISC_SUBPIXEL) & (DISC_SUBPIXEL - 1);
+    guint by = (guint)((dy - iy) * DISC_SUBPIXEL) & (DISC_SUBPIXEL - 1);
+    double radius_q = fmin(round(radius * scale * 4.0), 65535.0);
+
+    DiscEntry* e = disc_cache_get(cache, &p->color, (guint)radius_q, bx, by);
+    if (!e) {
+        // Out of memory for the surface; draw it the slow way
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
+        cairo_set_source_rgba(cr, p->color.r, p->color.g, p->color.b, p->color.a);
+        cairo_new_path(cr);
+        cairo_arc(cr, x, y, radius, 0, PI*2);
+        cairo_fill(cr);
+        return;
+    }
+    cairo_set_source_surface(cr, e->surface, (ix - e->pad) / scale, (iy - e->pad) / scale);
+    cairo_paint(cr);
 }
 
-static void point_draw(Point* p, cairo_t* cr) {
-    cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
-    cairo_set_source_rgba(cr, p->color.r, p->color.g, p->color.b, p->color.a);
-    cairo_new_path(cr);
-    cairo_arc(cr, p->curPos.x, p->curPos.y, p->radius, 0, PI*2);
-    cairo_fill(cr);
+// Widget pixels a ball's disc can touch, with room for antialiasing and the
+// sub-pixel snapping of the cached surfaces
+static cairo_rectangle_int_t point_bounds(const Point* p, const ViewTransform* view) {
+    double x = view_x(view, p->drawPos.x);
+    double y = view_y(view, p->drawPos.y);
+    double radius = p->drawRadius * view->scale;
+    cairo_rectangle_int_t r;
+    r.x = (int)floor(x - radius) - 2;
+    r.y = (int)floor(y - radius) - 2;
+    r.width = (int)ceil(x + radius) + 2 - r.x;
+    r.height = (int)ceil(y + radius) + 2 - r.y;
+    return r;
 }
 
-static void point_collection_update(PointCollection* pc) {
+// Every ball remembers the closest spot on segment a-b, if it's closer than
+// what it had
+static void point_collection_sweep(PointCollection* pc, Vector3 a, Vector3 b) {
+    double sx = b.x - a.x, sy = b.y - a.y;
+    double lengthSq = sx * sx + sy * sy;
     for (size_t i = 0; i < pc->count; ++i) {
         Point* point = &pc->points[i];
+        double t = lengthSq > 0 ? ((point->curPos.x - a.x) * sx + (point->curPos.y - a.y) * sy) / lengthSq : 0;
+        t = fmin(fmax(t, 0.0), 1.0);
+        double cx = a.x + sx * t, cy = a.y + sy * t;
+        double d2 = (point->curPos.x - cx) * (point->curPos.x - cx) + (point->curPos.y - cy) * (point->curPos.y - cy);
+        if (d2 < point->nearestD2) {
+            point->nearestD2 = d2;
+            point->nearest.x = cx;
+            point->nearest.y = cy;
+        }
+    }
+}
+
+// Starts the cursor path for a step at where the cursor is now
+static void point_collection_begin_path(PointCollection* pc) {
+    for (size_t i = 0; i < pc->count; ++i) pc->points[i].nearestD2 = REPULSION_RADIUS * REPULSION_RADIUS;
+    point_collection_sweep(pc, pc->mousePos, pc->mousePos);
+}
+
+// Extends the path to a new cursor sample, in layout coordinates
+static void point_collection_move_cursor(PointCollection* pc, double x, double y) {
+    Vector3 to = { x, y, 0.0 };
+    point_collection_sweep(pc, pc->mousePos, to);
+    pc->mousePos = to;
+}
 
-        double dx = pc->mousePos.x - point->curPos.x;
-        double dy = pc->mousePos.y - point->curPos.y;
-        double d = sqrt(dx * dx + dy * dy);
+// Each ball is pushed away from the closest spot on the whole path the
+// cursor took since the last step, so a fast swipe can't skip over it
+static bool point_collection_update(PointCollection* pc) {
+    bool moving = false;
+    for (size_t i = 0; i < pc->count; ++i) {
+        Point* point = &pc->points[i];
+        point->prevPos = point->curPos;
+        point->prevRadius = point->radius;
 
-        if (d < 150.0) {
-            point->targetPos.x = point->curPos.x - dx;
-            point->targetPos.y = point->curPos.y - dy;
+        if (point->nearestD2 < REPULSION_RADIUS * REPULSION_RADIUS) {
+            point->targetPos.x = point->curPos.x - (point->nearest.x - point->curPos.x);
+            point->targetPos.y = point->curPos.y - (point->nearest.y - point->curPos.y);
         } else {
             point->targetPos.x = point->originalPos.x;
             point->targetPos.y = point->originalPos.y;
         }
 
-        point_update(point);
+        if (point_update(point)) moving = true;
     }
+    return moving;
 }
 
-static void point_collection_draw(PointCollection* pc, cairo_t* cr) {
+// Places every ball alpha of the way through the last step. Balls that moved
+// on screen add where they were and where they are now to dirty.
+static void point_collection_interpolate(PointCollection* pc, double alpha, cairo_region_t* dirty) {
     for (size_t i = 0; i < pc->count; ++i) {
-        point_draw(&pc->points[i], cr);
+        Point* point = &pc->points[i];
+        Vector3 pos = point->prevPos;
+        pos.x += (point->curPos.x - point->prevPos.x) * alpha;
+        pos.y += (point->curPos.y - point->prevPos.y) * alpha;
+        double radius = point->prevRadius + (point->radius - point->prevRadius) * alpha;
+        if (pos.x == point->drawPos.x && pos.y == point->drawPos.y && radius == point->drawRadius) continue;
+
+        cairo_rectangle_int_t beforeBounds = point_bounds(point, &pc->view);
+        point->drawPos = pos;
+        point->drawRadius = radius;
+        cairo_rectangle_int_t afterBounds = point_bounds(point, &pc->view);
+        cairo_region_union_rectangle(dirty, &beforeBounds);
+        cairo_region_union_rectangle(dirty, &afterBounds);
+    }
+}
+
+static void point_collection_draw(PointCollection* pc, cairo_t* cr, DiscCache* cache) {
+    // Usually only the damage around the cursor is being redrawn
+    double clipX0, clipY0, clipX1, clipY1;
+    cairo_clip_extents(cr, &clipX0, &clipY0, &clipX1, &clipY1);
+
+    for (size_t i = 0; i < pc->count; ++i) {
+        cairo_rectangle_int_t b = point_bounds(&pc->points[i], &pc->view);
+        if (b.x >= clipX1 || b.y >= clipY1 || b.x + b.width <= clipX0 || b.y + b.height <= clipY0) continue;
+        point_draw(&pc->points[i], cr, cache, &pc->view);
     }
 }
 
@@ -194,18 +488,12 @@ static void point_collection_draw(PointCollection* pc, cairo_t* cr) {
 static void app_init_points(App* app) {    
     app->pc.points = (Point*)calloc(N, sizeof(Point));
     app->pc.count = N;
-
-    double logoW, logoH;
-    compute_pointdata_bounds(&logoW, &logoH);
-
-    // divide it by 2 to be in the center (vewy logic :nerd:)
-    double centerX = (app->width / 2.0) - (logoW / 2.0);
-    double centerY = (app->height / 2.0) - (logoH / 2.0);
+    app->pc.view = view_centered(app->width, app->height);
 
     for (size_t i = 0; i < N; ++i) {
         Point* p = &app->pc.points[i];
-        double x = centerX + pointData[i].x;
-        double y = centerY + pointData[i].y;
+        double x = pointData[i].x;
+        double y = pointData[i].y;
 
         p->curPos.x = x; p->curPos.y = y; p->curPos.z = 0.0;
         p->originalPos = p->curPos;
@@ -213,6 +501,8 @@ static void app_init_points(App* app) {
         p->velocity.x = p->velocity.y = p->velocity.z = 0.0;
         p->size = (double)pointData[i].size;
         p->radius = p->size;
+        p->prevPos = p->drawPos = p->curPos;
+        p->prevRadius = p->drawRadius = p->radius;
         p->friction = 0.8;
         p->springStrength = 0.1;
         p->color = color_from_hex(pointData[i].color);
@@ -222,68 +512,118 @@ static void app_init_points(App* app) {
 // GTK callbacks
 static gboolean on_draw(GtkWidget* widget, cairo_t* cr, gpointer user_data) {
     App* app = (App*)user_data;
-    (void)widget;
+
+    // Discs are rendered in device pixels, so after a scale change (moving
+    // to a HiDPI monitor) every cached one is the wrong size
+    int scale = gtk_widget_get_scale_factor(widget);
+    if (scale != app->discs.scale) {
+        disc_cache_clear(&app->discs);
+        app->discs.scale = scale;
+    }
 
     // Background white
     cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
     cairo_paint(cr);
 
     // Draw points
-    point_collection_draw(&app->pc, cr);
+    point_collection_draw(&app->pc, cr, &app->discs);
 
     return FALSE;
 }
 
+// Animation runs off the frame clock, so frames line up with the display's
+// refresh, and the tick callback is dropped once everything has settled
+static gboolean on_tick(GtkWidget* widget, GdkFrameClock* clock, gpointer user_data) {
+    App* app = (App*)user_data;
+    if (!app->running) {
+        app->tick_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    gint64 now = gdk_frame_clock_get_frame_time(clock);
+    if (app->last_frame_us == 0) {
+        // First frame after waking up: step on the input straight away
+        app->accumulator_us = PHYSICS_STEP_US;
+    } else {
+        app->accumulator_us += now - app->last_frame_us;
+        if (app->accumulator_us > PHYSICS_STEP_US * MAX_STEPS_PER_FRAME)
+            app->accumulator_us = PHYSICS_STEP_US * MAX_STEPS_PER_FRAME;
+    }
+    app->last_frame_us = now;
+
+    // Each step sweeps the cursor through the samples that arrived before
+    // the step's time (the frame clock runs on g_get_monotonic_time() too);
+    // the frame's last step takes the rest. Samples wait in the queue on
+    // frames that don't step.
+    const ViewTransform* view = &app->pc.view;
+    while (app->accumulator_us >= PHYSICS_STEP_US) {
+        app->accumulator_us -= PHYSICS_STEP_US;
+        bool last = app->accumulator_us < PHYSICS_STEP_US;
+        gint64 step_end_us = now - app->accumulator_us;
+
+        point_collection_begin_path(&app->pc);
+        InputSample sample;
+        while (input_queue_peek(&app->input, &sample) && (last || sample.time_us <= step_end_us)) {
+            input_queue_pop(&app->input, &sample);
+            point_collection_move_cursor(&app->pc, (sample.x - view->offsetX) / view->scale,
+                                         (sample.y - view->offsetY) / view->scale);
+        }
+        app->moving = point_collection_update(&app->pc);
+    }
+
+    // Frames land between physics steps, so the balls are drawn part of the
+    // way through the last one; once they've settled, where they stopped
+    double alpha = app->moving ? (double)app->accumulator_us / (double)PHYSICS_STEP_US : 1.0;
+    cairo_region_t* dirty = cairo_region_create();
+    point_collection_interpolate(&app->pc, alpha, dirty);
+
+    // Only repaint around the balls that moved
+    int rects = cairo_region_num_rectangles(dirty);
+    for (int i = 0; i < rects; ++i) {
+        cairo_rectangle_int_t r;
+        cairo_region_get_rectangle(dirty, i, &r);
+        gtk_widget_queue_draw_area(widget, r.x, r.y, r.width, r.height);
+    }
+    cairo_region_destroy(dirty);
+
+    if (!app->moving) {
+        app->tick_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void app_wake(App* app) {
+    if (app->tick_id || !app->running || !app->drawing_area) return;
+    app->last_frame_us = 0;
+    app->moving = TRUE;
+    app->tick_id = gtk_widget_add_tick_callback(app->drawing_area, on_tick, app, NULL);
+}
+
 static gboolean on_motion_notify(GtkWidget* widget, GdkEventMotion* event, gpointer user_data) {
     App* app = (App*)user_data;
     (void)widget;
-    app->pc.mousePos.x = event->x;
-    app->pc.mousePos.y = event->y;
+    input_queue_push(&app->input, event->x, event->y);
+    app_wake(app);
     return TRUE;
 }
 
 static void on_size_allocate(GtkWidget* widget, GdkRectangle* allocation, gpointer user_data) {
     App* app = (App*)user_data;
     (void)widget;
-    int oldW = app->width;
-    int oldH = app->height;
-
     app->width = allocation->width;
     app->height = allocation->height;
-
-    if (app->pc.points && app->pc.count > 0 && (oldW != 0 && oldH != 0)) {
-        double oldCenterX = (oldW / 2.0) - 180.0;
-        double oldCenterY = (oldH / 2.0) - 65.0;
-        double newCenterX = (app->width / 2.0) - 180.0;
-        double newCenterY = (app->height / 2.0) - 65.0;
-
-        for (size_t i = 0; i < app->pc.count; ++i) {
-            Point* p = &app->pc.points[i];
-            double relX = p->originalPos.x - oldCenterX;
-            double relY = p->originalPos.y - oldCenterY;
-
-            p->originalPos.x = newCenterX + relX;
-            p->originalPos.y = newCenterY + relY;
-
-            p->curPos.x = p->originalPos.x;
-            p->curPos.y = p->originalPos.y;
-
-            // Reset target and velocity to avoid sudden jumps on resize
-            p->targetPos = p->originalPos;
-            p->velocity.x = p->velocity.y = p->velocity.z = 0.0;
-        }
-    }
-}
-
-static gboolean on_timeout(gpointer user_data) {
-    App* app = (App*)user_data;
-    if (!app->running) return FALSE;
-
-    point_collection_update(&app->pc);
-    if (app->drawing_area) {
-        gtk_widget_queue_draw(app->drawing_area);
-    }
-    return TRUE;
+    if (!app->pc.points) return;
+
+    // Only the view moves; the cursor stays where it is on screen, so it
+    // has a new spot in the layout
+    ViewTransform old = app->pc.view;
+    ViewTransform view = view_centered(app->width, app->height);
+    if (view.offsetX == old.offsetX && view.offsetY == old.offsetY && view.scale == old.scale) return;
+    app->pc.mousePos.x = (view_x(&old, app->pc.mousePos.x) - view.offsetX) / view.scale;
+    app->pc.mousePos.y = (view_y(&old, app->pc.mousePos.y) - view.offsetY) / view.scale;
+    app->pc.view = view;
+    app_wake(app);
 }
 
 static void on_destroy(GtkWidget* widget, gpointer user_data) {
@@ -294,6 +634,7 @@ static void on_destroy(GtkWidget* widget, gpointer user_data) {
         free(app->pc.points);
         app->pc.points = NULL;
     }
+    disc_cache_free(&app->discs);
     gtk_main_quit();
 }
 
@@ -305,6 +646,8 @@ int main(int argc, char** argv) {
     app.width = 800;
     app.height = 600;
     app.running = TRUE;
+    input_queue_init(&app.input);
+    disc_cache_init(&app.discs);
 
     app.window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(app.window), "Google Balls Desktop (GTK3)");
@@ -343,17 +686,19 @@ int main(int argc, char** argv) {
 
     gtk_widget_show_all(app.window);
 
+    // GTK merges queued motion events by default; keep every sample
+    gdk_window_set_event_compression(gtk_widget_get_window(app.drawing_area), FALSE);
+
     // Initialize points after widget is realized to get actual size
     GtkAllocation alloc;
     gtk_widget_get_allocation(app.drawing_area, &alloc);
     app.width = alloc.width > 0 ? alloc.width : app.width;
     app.height = alloc.height > 0 ? alloc.height : app.height;
-    app.pc.mousePos.x = app.width / 2.0;
-    app.pc.mousePos.y = app.height / 2.0;
-
     app_init_points(&app);
+    app.pc.mousePos.x = (app.width / 2.0 - app.pc.view.offsetX) / app.pc.view.scale;
+    app.pc.mousePos.y = (app.height / 2.0 - app.pc.view.offsetY) / app.pc.view.scale;
 
-    g_timeout_add(30, on_timeout, &app);
+    app_wake(&app);
 
     gtk_main();
     return 0;
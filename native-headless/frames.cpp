@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+#include <string>
+
+#include "../native-common/frame_export.h"
+
+// A small consumer for google-balls-headless, and the reference for writing
+// one: it takes every frame the way a real consumer would (latest(), use the
+// pixels in place, then valid()) and reports what it saw. Handy for checking
+// an exporter is up without setting OBS up first.
+
+static uint64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static std::string default_socket_path() {
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    return std::string(runtime_dir && *runtime_dir ? runtime_dir : "/tmp") + "/google-balls.sock";
+}
+
+// Reads the whole frame, like an encoder or a texture upload would, and
+// counts the pixels that aren't background
+static long ball_pixels(const FrameImporter &in, const FrameImporter::Frame &frame) {
+    long count = 0;
+    for (int y = 0; y < in.height(); y++) {
+        const uint32_t *row = frame.pixels + (size_t)y * (in.stride() / 4);
+        for (int x = 0; x < in.width(); x++) count += row[x] != 0xFFFFFFFF;
+    }
+    return count;
+}
+
+static bool write_ppm(const char *path, const FrameImporter &in, const FrameImporter::Frame &frame) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", in.width(), in.height());
+    for (int y = 0; y < in.height(); y++) {
+        const uint32_t *row = frame.pixels + (size_t)y * (in.stride() / 4);
+        for (int x = 0; x < in.width(); x++) {
+            unsigned char rgb[3] = { (unsigned char)(row[x] >> 16), (unsigned char)(row[x] >> 8), (unsigned char)row[x] };
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv) {
+    std::string socket_path = default_socket_path();
+    long frames_wanted = 100;
+    const char *ppm_path = NULL;
+    bool poke = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--socket=", 9) == 0) {
+            socket_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--frames=", 9) == 0) {
+            frames_wanted = atol(argv[i] + 9);
+        } else if (strncmp(argv[i], "--ppm=", 6) == 0) {
+            ppm_path = argv[i] + 6;
+        } else if (strcmp(argv[i], "--poke") == 0) {
+            poke = true;
+        } else {
+            fprintf(stderr, "usage: %s [--socket=PATH] [--frames=N] [--ppm=PATH] [--poke]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    FrameImporter in;
+    std::string error;
+    if (!in.connect(socket_path, error)) {
+        fprintf(stderr, "Can't connect to %s: %s\n", socket_path.c_str(), error.c_str());
+        return 1;
+    }
+    printf("%dx%d frames from %s\n", in.width(), in.height(), socket_path.c_str());
+
+    // The balls only move, and frames only come, when something pushes them;
+    // --poke drags a pointer across the middle of the logo
+    int poke_step = 0;
+    const int poke_steps = 40;
+
+    long seen = 0, torn = 0, skipped = 0, covered = 0;
+    uint64_t last_frame = 0, max_age_us = 0, total_age_us = 0;
+    FrameImporter::Frame frame;
+    while (seen + torn < frames_wanted) {
+        if (poke && poke_step <= poke_steps) {
+            float x = in.width() * (0.25f + 0.5f * poke_step / poke_steps);
+            in.sendPointer(0, x, in.height() / 2.0f, poke_step == poke_steps);
+            poke_step++;
+        }
+
+        bool poking = poke && poke_step <= poke_steps;
+        struct pollfd pfd = { in.eventFd(), POLLIN, 0 };
+        int ready = poll(&pfd, 1, poking ? 16 : 5000);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready == 0) {
+            if (poking) continue;
+            fprintf(stderr, "No frame for 5s, the balls are probably at rest (try --poke)\n");
+            break;
+        }
+        if (ready < 0) continue;
+        uint64_t count;
+        if (read(in.eventFd(), &count, sizeof(count)) != sizeof(count)) continue;
+        if (!in.latest(frame) || frame.frameNumber == last_frame) continue;
+
+        long pixels = ball_pixels(in, frame);
+        uint64_t age_us = get_time_us() - frame.timestampUs;
+        // The producer drew over the slot while it was being read: a real
+        // consumer drops what it got and waits for the next one
+        if (!in.valid(frame)) {
+            torn++;
+            continue;
+        }
+
+        if (last_frame && frame.frameNumber > last_frame + 1) skipped += (long)(frame.frameNumber - last_frame - 1);
+        last_frame = frame.frameNumber;
+        seen++;
+        covered = pixels;
+        total_age_us += age_us;
+        if (age_us > max_age_us) max_age_us = age_us;
+    }
+
+    printf("%ld frames, %ld torn, %ld skipped, age when read avg %.2fms max %.2fms\n", seen, torn, skipped,
+           seen ? total_age_us / 1000.0 / seen : 0.0, max_age_us / 1000.0);
+    if (seen) printf("Balls cover %.1f%% of the last frame\n", 100.0 * covered / ((double)in.width() * in.height()));
+
+    // Writing the file is slow next to a frame, so it's checked like any read
+    if (ppm_path) {
+        if (!in.latest(frame) || !write_ppm(ppm_path, in, frame) || !in.valid(frame)) {
+            fprintf(stderr, "Couldn't write an intact frame to %s\n", ppm_path);
+            return 1;
+        }
+        printf("Frame %llu written to %s\n", (unsigned long long)frame.frameNumber, ppm_path);
+    }
+    return torn ? 2 : 0;
+}
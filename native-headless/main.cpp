@@ -0,0 +1,164 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <vector>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#include "../native-common/tiled_raster.h"
+#include "../native-common/simulation_thread.h"
+#include "../native-common/frame_export.h"
+
+// No window at all: the balls are drawn into shared memory for other
+// processes on this machine (OBS, a signage player) to show, see
+// frame_export.h. Frames go straight into the buffers the consumers map, so
+// nothing is copied or captured on either side.
+
+static int width = 1280, height = 720;
+static bool running = true;
+
+// Consumers can send pointer input back; the physics tick drains it
+static InputQueue<1024> inputQueue;
+
+// Physics runs on its own thread, which sleeps while everything is at rest.
+// Each tick it publishes a snapshot and bumps sim_fd; every snapshot becomes
+// one exported frame, and at rest the last one just stays up.
+static const int physics_step_ms = 30;
+static SimulationThread *simulation;
+static int sim_fd = -1;
+
+static FrameExporter exporter;
+static PointCollection pointCollection; // owned by the simulation thread
+static TiledRasterizer *rasterizer;
+static std::vector<raster::Disc> discs;
+
+static uint64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void initPoints() {
+    std::vector<PointData> pointData = logoPoints();
+
+    double logo_width, logo_height;
+    computeBounds(pointData, logo_width, logo_height);
+    ViewTransform view = ViewTransform::centered(logo_width, logo_height, width, height);
+
+    // The points are built on the thread that owns them, in logo coordinates
+    simulation->post([pointData, view](PointCollection& points) {
+        points.points.clear();
+        for (const auto& data : pointData) {
+            points.addPoint(data.x, data.y, 0.0, static_cast<double>(data.size), data.color);
+        }
+        points.setView(view);
+    });
+}
+
+static void draw_frame() {
+    raster::Target target = exporter.target();
+    simulation->snapshot().collectDiscs(discs);
+    rasterizer->render(target, 0xFFFFFFFF, discs);
+    exporter.publish(get_time_us());
+}
+
+static std::string default_socket_path() {
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    return std::string(runtime_dir && *runtime_dir ? runtime_dir : "/tmp") + "/google-balls.sock";
+}
+
+int main(int argc, char **argv) {
+    std::string socket_path = default_socket_path();
+    int slots = 3;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--size=", 7) == 0) {
+            if (sscanf(argv[i] + 7, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                fprintf(stderr, "--size wants WIDTHxHEIGHT, like 1920x1080\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--socket=", 9) == 0) {
+            socket_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--slots=", 8) == 0) {
+            slots = atoi(argv[i] + 8);
+        } else {
+            fprintf(stderr, "usage: %s [--size=WxH] [--socket=PATH] [--slots=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Signals are read from a signalfd in the main loop. They have to be
+    // blocked before any thread exists, which includes the rasterizer's.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    sim_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (signal_fd < 0 || sim_fd < 0) { fprintf(stderr, "Failed to create signal or event fd: %m\n"); return 1; }
+
+    std::string error;
+    if (!exporter.start(socket_path, width, height, slots, error)) {
+        fprintf(stderr, "Can't export frames on %s: %s\n", socket_path.c_str(), error.c_str());
+        return 1;
+    }
+    fprintf(stderr, "Exporting %dx%d frames on %s\n", width, height, socket_path.c_str());
+
+    TiledRasterizer frame_rasterizer;
+    rasterizer = &frame_rasterizer;
+
+    SimulationThread physics(pointCollection, inputQueue, physics_step_ms * 1000);
+    simulation = &physics;
+    physics.start([]() {
+        // Can only fail once the counter is saturated, and then it's set anyway
+        uint64_t one = 1;
+        ssize_t written = write(sim_fd, &one, sizeof(one));
+        (void)written;
+    });
+    initPoints();
+    physics.wake();
+
+    struct pollfd fds[3];
+    fds[0].fd = exporter.fd();
+    fds[1].fd = sim_fd;
+    fds[2].fd = signal_fd;
+    fds[0].events = fds[1].events = fds[2].events = POLLIN;
+
+    while (running) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if ((fds[0].revents & POLLIN) && exporter.dispatch(inputQueue)) physics.wake();
+
+        if (fds[2].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) running = false;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t ticks;
+            uint64_t input_us;
+            if (read(sim_fd, &ticks, sizeof(ticks)) == sizeof(ticks) && simulation->acquire(input_us)) {
+                draw_frame();
+            }
+        }
+    }
+
+    physics.stop();
+    exporter.stop();
+    close(sim_fd);
+    close(signal_fd);
+
+    return 0;
+}
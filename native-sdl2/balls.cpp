@@ -1,378 +1,465 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+// SDL's own copy of the GLES2 headers, so --gl builds where the system has
+// none (macOS, MinGW); the library itself is only loaded at runtime
+#define SDL_USE_BUILTIN_OPENGL_DEFINITIONS
+#include <SDL2/SDL_opengles2.h>
 #include <vector>
 #include <cmath>
 #include <string>
 #include <algorithm>
 #include "icon/balls.h"
+#include "../native-common/tiled_raster.h"
+#include "../native-common/latency.h"
+#include "../native-common/simulation_thread.h"
+#include "../native-common/gl_renderer.h"
 
-struct Vector3 {
-    double x, y, z;
-    
-    Vector3(double x = 0, double y = 0, double z = 0) : x(x), y(y), z(z) {}
-    
-    void set(double newX, double newY, double newZ = 0) {
-        x = newX; y = newY; z = newZ;
-    }
-    
-    void addX(double dx) { x += dx; }
-    void addY(double dy) { y += dy; }
-    void addZ(double dz) { z += dz; }
+void set_icon(SDL_Window *window) {
+	SDL_RWops *rw = SDL_RWFromConstMem(icon, icon_size);
+	if (!rw) {
+		SDL_Log("Failed to create RWops: %s", SDL_GetError());
+		return;
+	}
+
+	SDL_Surface *icon = IMG_Load_RW(rw, 1); // 1 = auto-free rw
+	if (!icon) {
+		SDL_Log("Failed to load PNG from memory: %s", IMG_GetError());
+		return;
+	}
+
+	SDL_SetWindowIcon(window, icon);
+	SDL_FreeSurface(icon);
+}
+
+// Pointer ids handed to the simulation: the mouse is 0, then a block for
+// touch fingers and one for gamepad sticks
+static const Uint32 FINGER_POINTERS = 0x10000;
+static const Uint32 GAMEPAD_POINTERS = 0x20000;
+
+// A gamepad steers its own cursor with the left stick
+struct Gamepad {
+    SDL_GameController* controller;
+    SDL_JoystickID id;
+    double x, y;
+};
+
+// One window onto the scene. x, y is where its corner sits in scene
+// coordinates: 0, 0 for the usual single window, and the display's place on
+// the desktop with --all-displays, so the logo spans the monitors as laid out
+struct Viewport {
+    SDL_Window* window;
+    Uint32 windowId;
+    SDL_Renderer* renderer;
+    SDL_Texture* frame;   // renderer and frame stay null with --gl
+    int x, y, width, height;
+    int frameWidth, frameHeight;
 };
 
-struct Color {
-    Uint8 r, g, b, a;
+class App {
+private:
+    std::vector<Viewport> viewports;
+    SDL_GLContext glContext;  // only with --gl, shared by every window
+    GlRenderer glRenderer;
+    bool useGl;
+    bool allDisplays;
+    PointCollection pointCollection;
+    InputQueue<1024> inputQueue;
+    SimulationThread simulation;
+    Uint32 snapshotEvent; // pushed by the simulation thread when a tick is ready
+    bool inputQueued;
+    std::vector<Gamepad> gamepads;
+    TiledRasterizer rasterizer;
+    std::vector<raster::Disc> discs;     // the whole scene, collected once a tick
+    std::vector<raster::Disc> viewDiscs; // the ones reaching into the window being drawn
+    bool running;
+    double logoWidth, logoHeight; // layout size, for centring the view
+    bool predictCursor;
+    uint64_t renderUs; // how long the last render() took to reach the present
+    bool measureLatency;
+    InputLatency latency;
     
-    Color(Uint8 r = 255, Uint8 g = 255, Uint8 b = 255, Uint8 a = 255) 
-        : r(r), g(g), b(b), a(a) {}
+    static const int TICK_MS = 30;  // Match JavaScript exactly (30ms timeout)
+    static const int STICK_DEADZONE = 8000;
+    static constexpr double STICK_SPEED = 12.0; // pixels per tick at full tilt
     
-    // Convert hex string to color
-    static Color fromHex(const std::string& hex) {
-        if (hex[0] == '#') {
-            unsigned int value = std::stoul(hex.substr(1), nullptr, 16);
-            return Color((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF, 255);
+    // Streaming texture the balls are rasterized into, one per window size
+    bool createFrame(Viewport& vp) {
+        if (vp.frame) SDL_DestroyTexture(vp.frame);
+        vp.frame = SDL_CreateTexture(vp.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                     vp.width, vp.height);
+        if (!vp.frame) {
+            SDL_Log("Frame texture could not be created! SDL_Error: %s\n", SDL_GetError());
+            return false;
         }
-        return Color();
+        SDL_SetTextureBlendMode(vp.frame, SDL_BLENDMODE_NONE);
+        vp.frameWidth = vp.width;
+        vp.frameHeight = vp.height;
+        return true;
     }
-};
-
-class Point {
-public:
-    Vector3 curPos, originalPos, targetPos, velocity;
-    Color color;
-    double radius, size;
-    double friction = 0.8;
-    double springStrength = 0.1;
     
-    Point(double x, double y, double z, double size, const std::string& colorHex)
-        : curPos(x, y, z), originalPos(x, y, z), targetPos(x, y, z),
-          velocity(0, 0, 0), size(size), radius(size) {
-        color = Color::fromHex(colorHex);
+    bool openWindow(int windowX, int windowY, int width, int height, Uint32 flags, int sceneX, int sceneY) {
+        Viewport vp = { nullptr, 0, nullptr, nullptr, sceneX, sceneY, width, height, 0, 0 };
+        vp.window = SDL_CreateWindow("Google Balls Desktop (SDL2)", windowX, windowY, width, height,
+                                     SDL_WINDOW_SHOWN | flags | (useGl ? SDL_WINDOW_OPENGL : 0));
+        if (!vp.window) {
+            SDL_Log("Window could not be created! SDL_Error: %s\n", SDL_GetError());
+            return false;
+        }
+        vp.windowId = SDL_GetWindowID(vp.window);
+        set_icon(vp.window);
+        viewports.push_back(vp);
+        return true;
     }
     
-    void update() {
-        // X axis spring physics
-        double dx = targetPos.x - curPos.x;
-        double ax = dx * springStrength;
-        velocity.x += ax;
-        velocity.x *= friction;
-        
-        // Stop small oscillations
-        if (std::abs(dx) < 0.1 && std::abs(velocity.x) < 0.01) {
-            curPos.x = targetPos.x;
-            velocity.x = 0;
-        } else {
-            curPos.x += velocity.x;
-        }
-        
-        // Y axis spring physics
-        double dy = targetPos.y - curPos.y;
-        double ay = dy * springStrength;
-        velocity.y += ay;
-        velocity.y *= friction;
-        
-        // Stop small oscillations
-        if (std::abs(dy) < 0.1 && std::abs(velocity.y) < 0.01) {
-            curPos.y = targetPos.y;
-            velocity.y = 0;
-        } else {
-            curPos.y += velocity.y;
-        }
-        
-        // Z axis (depth) based on distance from original position
-        double dox = originalPos.x - curPos.x;
-        double doy = originalPos.y - curPos.y;
-        double dd = (dox * dox) + (doy * doy);
-        double d = std::sqrt(dd);
-        
-        targetPos.z = d / 100.0 + 1.0;
-        double dz = targetPos.z - curPos.z;
-        double az = dz * springStrength;
-        velocity.z += az;
-        velocity.z *= friction;
-        
-        // Stop small Z oscillations
-        if (std::abs(dz) < 0.01 && std::abs(velocity.z) < 0.001) {
-            curPos.z = targetPos.z;
-            velocity.z = 0;
-        } else {
-            curPos.z += velocity.z;
+    // Events without a window of their own, like touches on older SDL, go to the first
+    Viewport& viewportFor(Uint32 windowId) {
+        for (auto& vp : viewports) {
+            if (vp.windowId == windowId) return vp;
         }
-        
-        // Update radius based on depth
-        radius = size * curPos.z;
-        if (radius < 1) radius = 1;
+        return viewports[0];
     }
     
-    void draw(SDL_Renderer* renderer) {
-        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-        
-        // Anti-aliased filled circle using multiple samples
-        int x0 = static_cast<int>(curPos.x);
-        int y0 = static_cast<int>(curPos.y);
-        double r = radius;
-        
-        // Use subpixel sampling for anti-aliasing
-        for (int x = static_cast<int>(-r - 1); x <= static_cast<int>(r + 1); x++) {
-            for (int y = static_cast<int>(-r - 1); y <= static_cast<int>(r + 1); y++) {
-                double coverage = 0.0;
-                const int samples = 4; // 4x4 subpixel sampling
-                
-                for (int sx = 0; sx < samples; sx++) {
-                    for (int sy = 0; sy < samples; sy++) {
-                        double px = x + (sx + 0.5) / samples - 0.5;
-                        double py = y + (sy + 0.5) / samples - 0.5;
-                        double dist = std::sqrt(px * px + py * py);
-                        
-                        if (dist <= r) {
-                            coverage += 1.0 / (samples * samples);
-                        }
-                    }
-                }
-                
-                if (coverage > 0.0) {
-                    Uint8 alpha = static_cast<Uint8>(coverage * color.a);
-                    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, alpha);
-                    SDL_RenderDrawPoint(renderer, x0 + x, y0 + y);
-                }
-            }
+    // The box around every window, in scene coordinates
+    void sceneBounds(int& x0, int& y0, int& x1, int& y1) const {
+        x0 = y0 = 0x7FFFFFFF;
+        x1 = y1 = -0x7FFFFFFF;
+        for (const auto& vp : viewports) {
+            x0 = std::min(x0, vp.x);
+            y0 = std::min(y0, vp.y);
+            x1 = std::max(x1, vp.x + vp.width);
+            y1 = std::max(y1, vp.y + vp.height);
         }
     }
-};
-
-// Original point data from JavaScript (adjusted for center positioning)
-struct PointData {
-    int x, y;
-    int size;
-    std::string color;
-};
-static void computeBounds(const std::vector<PointData>& data, double& w, double& h) {
-    int minX = 99999, maxX = -99999;
-    int minY = 99999, maxY = -99999;
     
-    for (const auto& p : data) {
-        if (p.x < minX) minX = p.x;
-        if (p.x > maxX) maxX = p.x;
-        if (p.y < minY) minY = p.y;
-        if (p.y > maxY) maxY = p.y;
+    // The logo in the middle of the scene, however many windows show it
+    ViewTransform sceneView() const {
+        int x0, y0, x1, y1;
+        sceneBounds(x0, y0, x1, y1);
+        ViewTransform view = ViewTransform::centered(logoWidth, logoHeight, x1 - x0, y1 - y0);
+        view.offsetX += x0;
+        view.offsetY += y0;
+        return view;
     }
     
-    w = maxX - minX;
-    h = maxY - minY;
-}
-
-class PointCollection {
 public:
-    Vector3 mousePos;
-    std::vector<Point> points;
+    App() : glContext(nullptr), useGl(false), allDisplays(false),
+            simulation(pointCollection, inputQueue, TICK_MS * 1000), snapshotEvent(0), inputQueued(false),
+            running(false), logoWidth(0), logoHeight(0),
+            predictCursor(false), renderUs(0), measureLatency(false) {}
     
-    PointCollection() : mousePos(0, 0, 0) {}
+    // Extrapolate pointers to when the frame is presented, see CursorPredictor
+    void setCursorPrediction(bool enabled) { predictCursor = enabled; }
     
-    void addPoint(double x, double y, double z, double size, const std::string& color) {
-        points.emplace_back(x, y, z, size, color);
-    }
+    // Report input-to-photon latency percentiles on exit
+    void setLatencyReport(bool enabled) { measureLatency = enabled; }
     
-    void update() {
-        for (auto& point : points) {
-            double dx = mousePos.x - point.curPos.x;
-            double dy = mousePos.y - point.curPos.y;
-            double dd = (dx * dx) + (dy * dy);
-            double d = std::sqrt(dd);
-            
-            if (d < 150) {
-                // Fixed: Match JavaScript logic exactly
-                point.targetPos.x = point.curPos.x - dx;
-                point.targetPos.y = point.curPos.y - dy;
-            } else {
-                point.targetPos.x = point.originalPos.x;
-                point.targetPos.y = point.originalPos.y;
-            }
-            
-            point.update();
-        }
-    }
+    // Draw with OpenGL ES 2 instead of rasterizing on the CPU, see GlRenderer
+    void setGlRenderer(bool enabled) { useGl = enabled; }
     
-    void draw(SDL_Renderer* renderer) {
-        for (auto& point : points) {
-            point.draw(renderer);
+    // Open a borderless window on every display instead of one window, all
+    // showing the one simulation
+    void setAllDisplays(bool enabled) { allDisplays = enabled; }
+    
+    // An ES 2 context for the windows, or false to go on with the SDL renderer.
+    // One context draws them all, so each tick is uploaded once.
+    bool initGl() {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+        glContext = SDL_GL_CreateContext(viewports[0].window);
+        if (!glContext) {
+            SDL_Log("OpenGL ES context could not be created, drawing on the CPU instead! SDL_Error: %s\n", SDL_GetError());
+            return false;
+        }
+        // Same as the SDL renderer: every snapshot is shown as soon as it's
+        // drawn. The interval belongs to the window, so set it on each.
+        for (const auto& vp : viewports) {
+            SDL_GL_MakeCurrent(vp.window, glContext);
+            SDL_GL_SetSwapInterval(0);
+        }
+        if (!glRenderer.init(SDL_GL_GetProcAddress)) {
+            SDL_GL_DeleteContext(glContext);
+            glContext = nullptr;
+            return false;
         }
+        return true;
     }
-};
-
-void set_icon(SDL_Window *window) {
-	SDL_RWops *rw = SDL_RWFromConstMem(icon, icon_size);
-	if (!rw) {
-		SDL_Log("Failed to create RWops: %s", SDL_GetError());
-		return;
-	}
-
-	SDL_Surface *icon = IMG_Load_RW(rw, 1); // 1 = auto-free rw
-	if (!icon) {
-		SDL_Log("Failed to load PNG from memory: %s", IMG_GetError());
-		return;
-	}
-
-	SDL_SetWindowIcon(window, icon);
-	SDL_FreeSurface(icon);
-}
-
-class App {
-private:
-    SDL_Window* window;
-    SDL_Renderer* renderer;
-    PointCollection pointCollection;
-    bool running;
-    int windowWidth, windowHeight;
-    
-public:
-    App() : window(nullptr), renderer(nullptr), running(false), 
-            windowWidth(800), windowHeight(600) {}
     
     bool init() {
-        if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0) {
             SDL_Log("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
             return false;
         }
         
-        window = SDL_CreateWindow("Google Balls Desktop (SDL2)",
-                                SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                                windowWidth, windowHeight,
-                                SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
-        
-        if (!window) {
-            SDL_Log("Window could not be created! SDL_Error: %s\n", SDL_GetError());
-            return false;
+        if (allDisplays) {
+            // Each window covers its display and sits in the scene where the
+            // display sits on the desktop
+            int count = SDL_GetNumVideoDisplays();
+            for (int i = 0; i < count; i++) {
+                SDL_Rect bounds;
+                if (SDL_GetDisplayBounds(i, &bounds) != 0) {
+                    SDL_Log("Display %d has no bounds, skipping it! SDL_Error: %s\n", i, SDL_GetError());
+                    continue;
+                }
+                if (!openWindow(bounds.x, bounds.y, bounds.w, bounds.h, SDL_WINDOW_BORDERLESS, bounds.x, bounds.y)) {
+                    return false;
+                }
+            }
         }
-        
-        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-        if (!renderer) {
-            SDL_Log("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+        if (viewports.empty() &&
+            !openWindow(SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 800, 600, SDL_WINDOW_RESIZABLE, 0, 0)) {
             return false;
         }
         
-        // Enable alpha blending for anti-aliasing
-        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-        
-        set_icon(window);
+        if (useGl) useGl = initGl();
+        if (!useGl) {
+            for (auto& vp : viewports) {
+                vp.renderer = SDL_CreateRenderer(vp.window, -1, SDL_RENDERER_ACCELERATED);
+                if (!vp.renderer) {
+                    SDL_Log("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+                    return false;
+                }
+                
+                if (!createFrame(vp)) {
+                    return false;
+                }
+            }
+        }
 
         initPoints();
+        
+        // Physics runs on its own thread from here on, see SimulationThread
+        snapshotEvent = SDL_RegisterEvents(1);
+        if (snapshotEvent == (Uint32)-1) {
+            SDL_Log("Could not register an event! SDL_Error: %s\n", SDL_GetError());
+            return false;
+        }
+        simulation.start([this]() {
+            SDL_Event e;
+            SDL_zero(e);
+            e.type = snapshotEvent;
+            SDL_PushEvent(&e);
+        });
+        
         running = true;
         return true;
     }
     
     void initPoints() {
-        std::vector<PointData> pointData = {
-            {202, 78, 9, "#ed9d33"}, {348, 83, 9, "#d44d61"}, {256, 69, 9, "#4f7af2"},
-            {214, 59, 9, "#ef9a1e"}, {265, 36, 9, "#4976f3"}, {300, 78, 9, "#269230"},
-            {294, 59, 9, "#1f9e2c"}, {45, 88, 9, "#1c48dd"}, {268, 52, 9, "#2a56ea"},
-            {73, 83, 9, "#3355d8"}, {294, 6, 9, "#36b641"}, {235, 62, 9, "#2e5def"},
-            {353, 42, 8, "#d53747"}, {336, 52, 8, "#eb676f"}, {208, 41, 8, "#f9b125"},
-            {321, 70, 8, "#de3646"}, {8, 60, 8, "#2a59f0"}, {180, 81, 8, "#eb9c31"},
-            {146, 65, 8, "#c41731"}, {145, 49, 8, "#d82038"}, {246, 34, 8, "#5f8af8"},
-            {169, 69, 8, "#efa11e"}, {273, 99, 8, "#2e55e2"}, {248, 120, 8, "#4167e4"},
-            {294, 41, 8, "#0b991a"}, {267, 114, 8, "#4869e3"}, {78, 67, 8, "#3059e3"},
-            {294, 23, 8, "#10a11d"}, {117, 83, 8, "#cf4055"}, {137, 80, 8, "#cd4359"},
-            {14, 71, 8, "#2855ea"}, {331, 80, 8, "#ca273c"}, {25, 82, 8, "#2650e1"},
-            {233, 46, 8, "#4a7bf9"}, {73, 13, 8, "#3d65e7"}, {327, 35, 6, "#f47875"},
-            {319, 46, 6, "#f36764"}, {256, 81, 6, "#1d4eeb"}, {244, 88, 6, "#698bf1"},
-            {194, 32, 6, "#fac652"}, {97, 56, 6, "#ee5257"}, {105, 75, 6, "#cf2a3f"},
-            {42, 4, 6, "#5681f5"}, {10, 27, 6, "#4577f6"}, {166, 55, 6, "#f7b326"},
-            {266, 88, 6, "#2b58e8"}, {178, 34, 6, "#facb5e"}, {100, 65, 6, "#e02e3d"},
-            {343, 32, 6, "#f16d6f"}, {59, 5, 6, "#507bf2"}, {27, 9, 6, "#5683f7"},
-            {233, 116, 6, "#3158e2"}, {123, 32, 6, "#f0696c"}, {6, 38, 6, "#3769f6"},
-            {63, 62, 6, "#6084ef"}, {6, 49, 6, "#2a5cf4"}, {108, 36, 6, "#f4716e"},
-            {169, 43, 6, "#f8c247"}, {137, 37, 6, "#e74653"}, {318, 58, 6, "#ec4147"},
-            {226, 100, 5, "#4876f1"}, {101, 46, 5, "#ef5c5c"}, {226, 108, 5, "#2552ea"},
-            {17, 17, 5, "#4779f7"}, {232, 93, 5, "#4b78f1"}
-        };
+        std::vector<PointData> pointData = logoPoints();
 		
-	    double logoW, logoH;
-	    computeBounds(pointData, logoW, logoH);
-	
-	    double offsetX = (windowWidth / 2.0) - (logoW / 2.0);
-	    double offsetY = (windowHeight / 2.0) - (logoH / 2.0);
+	    computeBounds(pointData, logoWidth, logoHeight);
 
-		// Center the points
+		// Points stay in logo coordinates, the view centres them
 	    for (const auto& data : pointData) {
-	        double x = offsetX + data.x;
-	        double y = offsetY + data.y;
-	        pointCollection.addPoint(x, y, 0.0, static_cast<double>(data.size), data.color);
+	        pointCollection.addPoint(data.x, data.y, 0.0, static_cast<double>(data.size), data.color);
 	    }
+	    pointCollection.setView(sceneView());
     }
     
-    void handleEvents() {
-        SDL_Event e;
-        while (SDL_PollEvent(&e)) {
-            switch (e.type) {
-                case SDL_QUIT:
-                    running = false;
-                    break;
-                case SDL_MOUSEMOTION:
-                    pointCollection.mousePos.set(e.motion.x, e.motion.y);
-                    break;
-                case SDL_WINDOWEVENT:
-                    if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
-                        windowWidth = e.window.data1;
-                        windowHeight = e.window.data2;
-                        // Recenter points on resize
-                        for (auto& point : pointCollection.points) {
-                            double relX = point.originalPos.x - (windowWidth/2 - 180);
-                            double relY = point.originalPos.y - (windowHeight/2 - 65);
-                            point.originalPos.x = (windowWidth/2 - 180) + relX;
-                            point.originalPos.y = (windowHeight/2 - 65) + relY;
-                            point.curPos.x = point.originalPos.x;
-                            point.curPos.y = point.originalPos.y;
-                        }
-                    }
-                    break;
+    void handleEvent(const SDL_Event& e) {
+        switch (e.type) {
+            case SDL_QUIT:
+                running = false;
+                break;
+            case SDL_MOUSEMOTION:
+                // Touches also arrive as fingers below, skip SDL's emulated mouse
+                if (e.motion.which != SDL_TOUCH_MOUSEID) {
+                    const Viewport& vp = viewportFor(e.motion.windowID);
+                    inputQueue.push(vp.x + e.motion.x, vp.y + e.motion.y);
+                    inputQueued = true;
+                }
+                break;
+            case SDL_FINGERDOWN:
+            case SDL_FINGERMOTION: {
+                // Finger coordinates are normalized 0.0-1.0 across the window
+                const Viewport& vp = viewportFor(e.tfinger.windowID);
+                inputQueue.push(vp.x + e.tfinger.x * vp.width, vp.y + e.tfinger.y * vp.height,
+                                FINGER_POINTERS + static_cast<Uint32>(e.tfinger.fingerId & 0xFFFF));
+                inputQueued = true;
+                break;
+            }
+            case SDL_FINGERUP:
+                inputQueue.release(FINGER_POINTERS + static_cast<Uint32>(e.tfinger.fingerId & 0xFFFF));
+                inputQueued = true;
+                break;
+            case SDL_CONTROLLERDEVICEADDED: {
+                SDL_GameController* controller = SDL_GameControllerOpen(e.cdevice.which);
+                if (controller) {
+                    // The cursor only starts pushing once the stick moves
+                    int x0, y0, x1, y1;
+                    sceneBounds(x0, y0, x1, y1);
+                    Gamepad pad = { controller, SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(controller)),
+                                    (x0 + x1) / 2.0, (y0 + y1) / 2.0 };
+                    gamepads.push_back(pad);
+                }
+                break;
             }
+            case SDL_CONTROLLERDEVICEREMOVED:
+                // which is the instance id here, not the device index
+                for (size_t i = 0; i < gamepads.size(); i++) {
+                    if (gamepads[i].id == e.cdevice.which) {
+                        inputQueue.release(GAMEPAD_POINTERS + static_cast<Uint32>(gamepads[i].id));
+                        inputQueued = true;
+                        SDL_GameControllerClose(gamepads[i].controller);
+                        gamepads.erase(gamepads.begin() + i);
+                        break;
+                    }
+                }
+                break;
+            case SDL_WINDOWEVENT:
+                if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
+                    Viewport& vp = viewportFor(e.window.windowID);
+                    vp.width = e.window.data1;
+                    vp.height = e.window.data2;
+                    // Recenter by moving the view, on the thread that owns it;
+                    // the balls themselves aren't touched
+                    ViewTransform view = sceneView();
+                    simulation.post([view](PointCollection& pc) { pc.setView(view); });
+                } else if (e.window.event == SDL_WINDOWEVENT_LEAVE) {
+                    // A mouse that left stops pushing, or the next one to
+                    // come in would sweep a line from where it went out
+                    inputQueue.release(0);
+                    inputQueued = true;
+                } else if (e.window.event == SDL_WINDOWEVENT_CLOSE) {
+                    // SDL_QUIT only comes once every window is closed, but
+                    // they all show the same thing, so closing one is enough
+                    running = false;
+                }
+                break;
+        }
+    }
+    
+    void pollGamepads() {
+        if (gamepads.empty()) return;
+        int x0, y0, x1, y1;
+        sceneBounds(x0, y0, x1, y1);
+        for (auto& pad : gamepads) {
+            Sint16 lx = SDL_GameControllerGetAxis(pad.controller, SDL_CONTROLLER_AXIS_LEFTX);
+            Sint16 ly = SDL_GameControllerGetAxis(pad.controller, SDL_CONTROLLER_AXIS_LEFTY);
+            if (std::abs(lx) <= STICK_DEADZONE && std::abs(ly) <= STICK_DEADZONE) continue;
+            pad.x = std::max(static_cast<double>(x0), std::min(static_cast<double>(x1), pad.x + lx / 32768.0 * STICK_SPEED));
+            pad.y = std::max(static_cast<double>(y0), std::min(static_cast<double>(y1), pad.y + ly / 32768.0 * STICK_SPEED));
+            inputQueue.push(pad.x, pad.y, GAMEPAD_POINTERS + static_cast<Uint32>(pad.id));
+            inputQueued = true;
         }
     }
     
-    void update() {
-        pointCollection.update();
+    void renderGl() {
+        uint64_t start = inputQueue.nowUs();
+        const SimulationSnapshot& snapshot = simulation.snapshot();
+        latency.frameSubmitted();
+        // The balls go up once a tick; each window only moves the view to its
+        // own corner of the scene, and the GPU clips away whatever is outside
+        for (const auto& vp : viewports) {
+            SDL_GL_MakeCurrent(vp.window, glContext);
+            int drawableWidth, drawableHeight;
+            SDL_GL_GetDrawableSize(vp.window, &drawableWidth, &drawableHeight);
+            glRenderer.draw(snapshot, 1.0, drawableWidth, drawableHeight,
+                            static_cast<double>(drawableWidth) / vp.width, vp.x, vp.y);
+            SDL_GL_SwapWindow(vp.window);
+        }
+        uint64_t presented = inputQueue.nowUs();
+        latency.presented(presented);
+        renderUs = presented - start;
+        simulation.setPredictionAhead(predictCursor ? renderUs : 0);
     }
     
     void render() {
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);  // White background
-        SDL_RenderClear(renderer);
-        
-        pointCollection.draw(renderer);
-        
-        SDL_RenderPresent(renderer);
+        if (useGl) {
+            renderGl();
+            return;
+        }
+        uint64_t start = inputQueue.nowUs();
+        // Physics ran once for every window; the scene is collected once too
+        // and each window only rasterizes the balls that reach into it, so
+        // the cost follows the pixels drawn rather than windows times balls
+        simulation.snapshot().collectDiscs(discs);
+        for (auto& vp : viewports) {
+            if ((vp.frameWidth != vp.width || vp.frameHeight != vp.height) && !createFrame(vp)) {
+                continue;
+            }
+            
+            viewDiscs.clear();
+            for (const auto& disc : discs) {
+                if (disc.x + disc.r < vp.x || disc.x - disc.r > vp.x + vp.width ||
+                    disc.y + disc.r < vp.y || disc.y - disc.r > vp.y + vp.height) continue;
+                raster::Disc local = disc;
+                local.x -= vp.x;
+                local.y -= vp.y;
+                viewDiscs.push_back(local);
+            }
+            
+            void* pixels;
+            int pitch;
+            if (SDL_LockTexture(vp.frame, nullptr, &pixels, &pitch) == 0) {
+                raster::Target target = { static_cast<Uint32*>(pixels), pitch / 4, vp.frameWidth, vp.frameHeight };
+                rasterizer.render(target, 0xFFFFFFFF, viewDiscs);  // White background
+                SDL_UnlockTexture(vp.frame);
+            }
+            
+            SDL_RenderCopy(vp.renderer, vp.frame, nullptr, nullptr);
+        }
+        latency.frameSubmitted();
+        for (const auto& vp : viewports) {
+            if (vp.frame) SDL_RenderPresent(vp.renderer);
+        }
+        uint64_t presented = inputQueue.nowUs();
+        latency.presented(presented);
+        renderUs = presented - start;
+        // A tick is drawn as soon as it is published, so it shows up about one render later
+        simulation.setPredictionAhead(predictCursor ? renderUs : 0);
     }
     
+    // The simulation ticks on its own thread; this one handles events and
+    // draws each snapshot it publishes, so a slow present only costs frames,
+    // never physics time
     void run() {
-        const int frameDelay = 30;  // Match JavaScript exactly (30ms timeout)
-        
-        Uint32 frameStart;
-        int frameTime;
-        
         while (running) {
-            frameStart = SDL_GetTicks();
-            
-            handleEvents();
-            update();
-            render();
-            
-            frameTime = SDL_GetTicks() - frameStart;
+            // Sleep until an event or a snapshot arrives. Sticks are polled,
+            // so with a gamepad connected wake up once a tick regardless.
+            SDL_Event e;
+            if (SDL_WaitEventTimeout(&e, gamepads.empty() ? -1 : TICK_MS)) {
+                handleEvent(e);
+                while (SDL_PollEvent(&e)) handleEvent(e);
+            }
+            pollGamepads();
+            if (inputQueued) {
+                simulation.wake();
+                inputQueued = false;
+            }
             
-            if (frameDelay > frameTime) {
-                SDL_Delay(frameDelay - frameTime);
+            uint64_t inputUs;
+            if (simulation.acquire(inputUs)) {
+                if (inputUs) latency.consumed(inputUs);
+                render();
             }
         }
     }
     
     void cleanup() {
-        if (renderer) {
-            SDL_DestroyRenderer(renderer);
-            renderer = nullptr;
+        simulation.stop();
+        
+        if (measureLatency) latency.print(stdout);
+        
+        for (auto& pad : gamepads) SDL_GameControllerClose(pad.controller);
+        gamepads.clear();
+        
+        for (auto& vp : viewports) {
+            if (vp.frame) SDL_DestroyTexture(vp.frame);
+        }
+        
+        if (glContext) {
+            glRenderer.destroy();
+            SDL_GL_DeleteContext(glContext);
+            glContext = nullptr;
         }
         
-        if (window) {
-            SDL_DestroyWindow(window);
-            window = nullptr;
+        for (auto& vp : viewports) {
+            if (vp.renderer) SDL_DestroyRenderer(vp.renderer);
+            SDL_DestroyWindow(vp.window);
         }
+        viewports.clear();
         
         SDL_Quit();
     }
@@ -381,6 +468,21 @@ public:
 int main(int argc, char* args[]) {
     App app;
     
+    for (int i = 1; i < argc; i++) {
+        if (std::string(args[i]) == "--predict") {
+            app.setCursorPrediction(true);
+        } else if (std::string(args[i]) == "--latency") {
+            app.setLatencyReport(true);
+        } else if (std::string(args[i]) == "--gl") {
+            app.setGlRenderer(true);
+        } else if (std::string(args[i]) == "--all-displays") {
+            app.setAllDisplays(true);
+        } else {
+            SDL_Log("usage: %s [--predict] [--latency] [--gl] [--all-displays]", args[0]);
+            return 1;
+        }
+    }
+    
     if (!app.init()) {
         SDL_Log("Failed to initialize!");
         return -1;
@@ -6,9 +6,14 @@
 #include <thread>
 #include <sstream>
 #include <cstring>
-#include <map>
 #include <memory>
 #include <csignal>
+#include <cstdlib>
+
+#include "metrics.h"
+#include "graphics.h"
+#include "palette.h"
+#include "stream.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -18,15 +23,25 @@
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #endif
 
+// Balls are shrunk to stay legible as characters; pixel output undoes this
+const double CELL_BALL_SCALE = 0.3;
+
 // Global flag for window resize
 volatile sig_atomic_t g_windowResized = 0;
+// Set from SIGUSR1; the frame loop writes the metrics file when it sees it
+volatile sig_atomic_t g_metricsDumpRequested = 0;
 
 #ifndef _WIN32
 void handleResize(int sig) {
     g_windowResized = 1;
 }
+
+void handleMetricsDump(int sig) {
+    g_metricsDumpRequested = 1;
+}
 #endif
 
 struct Vector3 {
@@ -46,16 +61,13 @@ struct Color {
         }
         return Color();
     }
-    
-    std::string toAnsi() const {
-        return "\033[38;2;" + std::to_string(r) + ";" + std::to_string(g) + ";" + std::to_string(b) + "m";
-    }
 };
 
 class Point {
 public:
     Vector3 curPos, originalPos, targetPos, velocity;
     Color color;
+    uint16_t colorSlot = palette::NONE;
     double radius, size;
     double friction = 0.8;
     double springStrength = 0.1;
@@ -126,13 +138,17 @@ class TerminalCanvas {
 private:
     int width, height;
     std::vector<std::string> buffer;
-    std::vector<Color> colorBuffer;
+    std::vector<uint16_t> colorSlots;   // Palette slots, palette::NONE when blank
     std::vector<std::pair<int, int>> dirtyPixels;
+    // What the last counted render() put on screen, only kept with --metrics
+    std::vector<char> shownGlyphs;
+    std::vector<uint16_t> shownSlots;
+    int changedCells;
     
 public:
-    TerminalCanvas(int w, int h) : width(w), height(h) {
+    TerminalCanvas(int w, int h) : width(w), height(h), changedCells(0) {
         buffer.resize(height, std::string(width, ' '));
-        colorBuffer.resize(height * width, Color(255, 255, 255));
+        colorSlots.resize(height * width, palette::NONE);
         dirtyPixels.reserve(1000);
     }
     
@@ -143,21 +159,21 @@ public:
             int y = pixel.second;
             if (y >= 0 && y < height && x >= 0 && x < width) {
                 buffer[y][x] = ' ';
-                colorBuffer[y * width + x] = Color(255, 255, 255);
+                colorSlots[y * width + x] = palette::NONE;
             }
         }
         dirtyPixels.clear();
     }
     
-    void setPixel(int x, int y, const std::string& c, const Color& color) {
+    void setPixel(int x, int y, const std::string& c, uint16_t slot) {
         if (x >= 0 && x < width && y >= 0 && y < height) {
             buffer[y][x] = c[0];
-            colorBuffer[y * width + x] = color;
+            colorSlots[y * width + x] = slot;
             dirtyPixels.push_back({x, y});
         }
     }
     
-    void drawCircle(int cx, int cy, double radius, const Color& color) {
+    void drawCircle(int cx, int cy, double radius, uint16_t slot) {
         // Use different characters based on size for better visual
         const char* chars = "●◉○◌";
         int charIdx = std::min(3, std::max(0, static_cast<int>(radius / 2)));
@@ -168,40 +184,61 @@ public:
             for (int x = -r; x <= r; x++) {
                 double dist = std::sqrt(x * x + y * y);
                 if (dist <= radius) {
-                    setPixel(cx + x, cy + y, c, color);
+                    setPixel(cx + x, cy + y, c, slot);
                 }
             }
         }
     }
     
-    std::string render() {
-        std::ostringstream oss;
-        oss << "\033[H"; // Move cursor to home
+    // countChanges is only set with --metrics, so the comparison below costs
+    // nothing otherwise
+    std::string render(const Palette& colors, bool countChanges) {
+        std::string out = "\033[H"; // Move cursor to home
         
         // Safety check - don't render if size is unreasonable
         if (width * height > 20000) {
-            oss << "Terminal too large to render\n";
-            return oss.str();
+            out += "Terminal too large to render\n";
+            return out;
         }
         
-        Color lastColor(0, 0, 0);
+        out.reserve(width * height * 2);
+        uint16_t lastSlot = palette::NONE;
+        changedCells = 0;
+        if (countChanges && shownGlyphs.empty()) {
+            shownGlyphs.resize(height * width, ' ');
+            shownSlots.resize(height * width, palette::NONE);
+        }
         for (int y = 0; y < height; y++) {
             for (int x = 0; x < width; x++) {
-                Color c = colorBuffer[y * width + x];
-                if (buffer[y][x] != ' ') {
-                    if (c.r != lastColor.r || c.g != lastColor.g || c.b != lastColor.b) {
-                        oss << c.toAnsi();
-                        lastColor = c;
+                int idx = y * width + x;
+                uint16_t slot = colorSlots[idx];
+                char glyph = buffer[y][x];
+                if (countChanges && (glyph != shownGlyphs[idx] || (glyph != ' ' && slot != shownSlots[idx]))) {
+                    changedCells++;
+                    shownGlyphs[idx] = glyph;
+                    shownSlots[idx] = slot;
+                }
+                if (glyph != ' ') {
+                    if (slot != lastSlot) {
+                        out += colors.escape(slot);
+                        lastSlot = slot;
                     }
-                    oss << buffer[y][x];
+                    out += glyph;
                 } else {
-                    oss << ' ';
+                    out += ' ';
                 }
             }
-            if (y < height - 1) oss << '\n';
+            if (y < height - 1) out += '\n';
         }
-        oss << "\033[0m"; // Reset color
-        return oss.str();
+        out += "\033[0m"; // Reset color
+        return out;
+    }
+    
+    int lastChangedCells() const { return changedCells; }
+    
+    CellFrame cells() const {
+        CellFrame frame = { width, height, &buffer, &colorSlots };
+        return frame;
     }
 };
 
@@ -241,6 +278,14 @@ public:
             h = 24;
         }
     }
+    
+    static bool getCellPixelSize(int& w, int& h) {
+        return false;
+    }
+    
+    static GraphicsProtocol detectGraphics() {
+        return GraphicsProtocol::None;
+    }
 #else
     static struct termios orig_termios;
     
@@ -253,8 +298,8 @@ public:
         raw.c_cc[VTIME] = 0;
         tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
         
-        // Hide cursor
-        std::cout << "\033[?25l" << std::flush;
+        // Hide cursor and turn on any-motion mouse reporting in SGR format
+        std::cout << "\033[?25l\033[?1003h\033[?1006h" << std::flush;
         
         // Set non-blocking input
         int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
@@ -262,11 +307,12 @@ public:
         
         // Setup resize signal handler
         signal(SIGWINCH, handleResize);
+        signal(SIGUSR1, handleMetricsDump);
     }
     
     static void restoreLinux() {
         tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios);
-        std::cout << "\033[?25h" << std::flush; // Show cursor
+        std::cout << "\033[?1006l\033[?1003l\033[?25h" << std::flush; // Mouse off, show cursor
     }
     
     static void getSize(int& w, int& h) {
@@ -280,6 +326,72 @@ public:
             h = ws.ws_row;
         }
     }
+    
+    // Sends a query and collects the reply until it contains `until`.
+    // stdin is already raw and non-blocking here.
+    static bool query(const std::string& request, const std::string& until, std::string& reply, int timeoutMs) {
+        std::cout << request << std::flush;
+        reply.clear();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (reply.find(until) == std::string::npos) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) return false;
+            struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+            if (poll(&pfd, 1, static_cast<int>(left)) <= 0) continue;
+            char buf[256];
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n > 0) reply.append(buf, n);
+        }
+        return true;
+    }
+    
+    static bool getCellPixelSize(int& w, int& h) {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_xpixel > 0 && ws.ws_ypixel > 0 &&
+            ws.ws_col > 0 && ws.ws_row > 0) {
+            w = ws.ws_xpixel / ws.ws_col;
+            h = ws.ws_ypixel / ws.ws_row;
+            return w > 0 && h > 0;
+        }
+        // Some terminals only answer the xterm "report cell size" query
+        std::string reply;
+        if (query("\033[16t", "t", reply, 200)) {
+            int ch = 0, cw = 0;
+            size_t at = reply.find("\033[6;");
+            if (at != std::string::npos && sscanf(reply.c_str() + at, "\033[6;%d;%dt", &ch, &cw) == 2 && cw > 0 && ch > 0) {
+                w = cw;
+                h = ch;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    static GraphicsProtocol detectGraphics() {
+        const char* term = getenv("TERM");
+        const char* program = getenv("TERM_PROGRAM");
+        if (getenv("KITTY_WINDOW_ID") || (term && strstr(term, "kitty")) ||
+            (program && (strcmp(program, "WezTerm") == 0 || strcmp(program, "ghostty") == 0))) {
+            return GraphicsProtocol::Kitty;
+        }
+        
+        // Ask directly: a kitty graphics query followed by primary device
+        // attributes. Every terminal answers the latter, so we never wait out
+        // the full timeout, and a 4 in the DA1 reply means sixel support.
+        std::string reply;
+        query("\033_Gi=31,s=1,v=1,a=q,t=d,f=24;AAAA\033\\\033[c", "c", reply, 500);
+        if (reply.find("\033_Gi=31;OK") != std::string::npos) return GraphicsProtocol::Kitty;
+        size_t da = reply.find("\033[?");
+        if (da != std::string::npos) {
+            std::string params = reply.substr(da + 3, reply.find('c', da) - da - 3);
+            std::stringstream ss(params);
+            std::string item;
+            while (std::getline(ss, item, ';')) {
+                if (item == "4") return GraphicsProtocol::Sixel;
+            }
+        }
+        return GraphicsProtocol::None;
+    }
 #endif
     
     static void setup() {
@@ -304,138 +416,187 @@ public:
 struct termios Terminal::orig_termios;
 #endif
 
+// One decoded input action, stamped with when its bytes were read
+struct InputEvent {
+    enum Type { MOVE, POINTER, QUIT } type;
+    double dx, dy;      // MOVE: cursor delta in simulation units
+    int col, row;       // POINTER: zero-based cell under the mouse
+    std::chrono::steady_clock::time_point time;
+};
+
 class InputManager {
 private:
-    std::map<int, bool> keyStates;
-    bool shiftPressed = false;
-    
-    enum Keys {
-        KEY_UP = 1,
-        KEY_DOWN = 2,
-        KEY_LEFT = 3,
-        KEY_RIGHT = 4,
-        KEY_SHIFT = 5,
-        KEY_QUIT = 6
-    };
+    // Raw bytes waiting to be parsed; a sequence split across reads stays
+    // here until the rest arrives.
+    static const size_t RING_SIZE = 4096;
+    char ring[RING_SIZE];
+    size_t ringHead = 0, ringTail = 0;  // tail - head bytes pending
     
-public:
-    void update() {
-#ifdef _WIN32
-        if (_kbhit()) {
-            int c = _getch();
-            
-            if (c == 'q' || c == 'Q' || c == 27) {
-                keyStates[KEY_QUIT] = true;
-            }
-            
-            if (c == 224 || c == 0) { // Arrow keys
-                c = _getch();
-                if (c == 72) keyStates[KEY_UP] = true;
-                if (c == 80) keyStates[KEY_DOWN] = true;
-                if (c == 75) keyStates[KEY_LEFT] = true;
-                if (c == 77) keyStates[KEY_RIGHT] = true;
-            }
-            
-            // Check for shift (capital WASD or actual shift detection)
-            if (c == 'W' || c == 'A' || c == 'S' || c == 'D') {
-                shiftPressed = true;
-                if (c == 'W') keyStates[KEY_UP] = true;
-                if (c == 'S') keyStates[KEY_DOWN] = true;
-                if (c == 'A') keyStates[KEY_LEFT] = true;
-                if (c == 'D') keyStates[KEY_RIGHT] = true;
-            } else if (c == 'w' || c == 'a' || c == 's' || c == 'd') {
-                shiftPressed = false;
-                if (c == 'w') keyStates[KEY_UP] = true;
-                if (c == 's') keyStates[KEY_DOWN] = true;
-                if (c == 'a') keyStates[KEY_LEFT] = true;
-                if (c == 'd') keyStates[KEY_RIGHT] = true;
-            }
+    static const size_t MAX_EVENTS = 256;
+    InputEvent events[MAX_EVENTS];
+    size_t eventCount = 0, eventRead = 0;
+    
+    char peek(size_t i) const { return ring[(ringHead + i) % RING_SIZE]; }
+    size_t pending() const { return ringTail - ringHead; }
+    
+    void push(const InputEvent& e) {
+        if (eventCount < MAX_EVENTS) events[eventCount++] = e;
+    }
+    
+    void pushMove(int dirX, int dirY, bool fast, std::chrono::steady_clock::time_point t) {
+        // y is in half rows, so vertical steps are doubled to feel even
+        double speedY = fast ? 4.0 : 2.0;
+        double speedX = fast ? 2.0 : 1.0;
+        InputEvent e = { InputEvent::MOVE, dirX * speedX, dirY * speedY, 0, 0, t };
+        push(e);
+    }
+    
+    void pushKey(char c, std::chrono::steady_clock::time_point t) {
+        switch (c) {
+            case 'q': case 'Q': { InputEvent e = { InputEvent::QUIT, 0, 0, 0, 0, t }; push(e); break; }
+            case 'w': pushMove(0, -1, false, t); break;
+            case 's': pushMove(0, 1, false, t); break;
+            case 'a': pushMove(-1, 0, false, t); break;
+            case 'd': pushMove(1, 0, false, t); break;
+            case 'W': pushMove(0, -1, true, t); break;
+            case 'S': pushMove(0, 1, true, t); break;
+            case 'A': pushMove(-1, 0, true, t); break;
+            case 'D': pushMove(1, 0, true, t); break;
         }
-#else
-        // Clear shift state each frame, will be set if shift+key detected
-        bool newShift = false;
+    }
+    
+    void pushArrow(char final, bool fast, std::chrono::steady_clock::time_point t) {
+        if (final == 'A') pushMove(0, -1, fast, t);
+        else if (final == 'B') pushMove(0, 1, fast, t);
+        else if (final == 'C') pushMove(1, 0, fast, t);
+        else if (final == 'D') pushMove(-1, 0, fast, t);
+    }
+    
+    // Handles "ESC [ params final". Returns bytes consumed, 0 if incomplete.
+    size_t parseCsi(std::chrono::steady_clock::time_point t) {
+        size_t n = pending();
+        size_t i = 2;
+        while (i < n && peek(i) >= 0x20 && peek(i) <= 0x3F) i++;
+        if (i >= n) return 0;
+        char final = peek(i);
         
-        char c;
-        while (read(STDIN_FILENO, &c, 1) > 0) {
-            if (c == 'q' || c == 'Q') {
-                keyStates[KEY_QUIT] = true;
+        std::string params;
+        for (size_t k = 2; k < i; k++) params += peek(k);
+        
+        if (!params.empty() && params[0] == '<' && (final == 'M' || final == 'm')) {
+            // SGR mouse (1006): ESC [ < button ; col ; row M|m
+            int button = 0, col = 0, row = 0;
+            if (sscanf(params.c_str() + 1, "%d;%d;%d", &button, &col, &row) == 3 && !(button & 64)) {
+                InputEvent e = { InputEvent::POINTER, 0, 0, col - 1, row - 1, t };
+                push(e);
             }
-            
-            if (c == '\033') {
-                char seq[5];
-                int bytesRead = read(STDIN_FILENO, &seq[0], 1);
-                if (bytesRead == 1) {
-                    if (seq[0] == '[') {
-                        bytesRead = read(STDIN_FILENO, &seq[1], 1);
-                        if (bytesRead == 1) {
-                            // Regular arrow keys
-                            if (seq[1] == 'A') { keyStates[KEY_UP] = true; continue; }
-                            if (seq[1] == 'B') { keyStates[KEY_DOWN] = true; continue; }
-                            if (seq[1] == 'D') { keyStates[KEY_LEFT] = true; continue; }
-                            if (seq[1] == 'C') { keyStates[KEY_RIGHT] = true; continue; }
-                            
-                            // Check for modified keys (shift+arrow)
-                            if (seq[1] == '1') {
-                                bytesRead = read(STDIN_FILENO, &seq[2], 1);
-                                if (bytesRead == 1 && seq[2] == ';') {
-                                    bytesRead = read(STDIN_FILENO, &seq[3], 1);
-                                    if (bytesRead == 1 && seq[3] == '2') {
-                                        bytesRead = read(STDIN_FILENO, &seq[4], 1);
-                                        if (bytesRead == 1) {
-                                            newShift = true;
-                                            if (seq[4] == 'A') { keyStates[KEY_UP] = true; continue; }
-                                            if (seq[4] == 'B') { keyStates[KEY_DOWN] = true; continue; }
-                                            if (seq[4] == 'D') { keyStates[KEY_LEFT] = true; continue; }
-                                            if (seq[4] == 'C') { keyStates[KEY_RIGHT] = true; continue; }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    } else {
-                        // ESC key pressed alone - quit
-                        keyStates[KEY_QUIT] = true;
-                    }
-                } else {
-                    // ESC with no following characters - quit
-                    keyStates[KEY_QUIT] = true;
-                }
+        } else if (final >= 'A' && final <= 'D') {
+            // Plain arrows or "1;mod" with mod-1 as a bitmask, bit 0 = shift
+            int mod = 1;
+            size_t semi = params.find(';');
+            if (semi != std::string::npos) mod = std::atoi(params.c_str() + semi + 1);
+            pushArrow(final, mod > 1 && ((mod - 1) & 1), t);
+        }
+        return i + 1;
+    }
+    
+    void parse(std::chrono::steady_clock::time_point t, bool moreComing) {
+        while (pending() > 0) {
+            char c = peek(0);
+            if (c != '\033') {
+                pushKey(c, t);
+                ringHead++;
+                continue;
             }
-            
-            // WASD keys
-            if (c == 'W' || c == 'A' || c == 'S' || c == 'D') {
-                newShift = true;
-                if (c == 'W') keyStates[KEY_UP] = true;
-                if (c == 'S') keyStates[KEY_DOWN] = true;
-                if (c == 'A') keyStates[KEY_LEFT] = true;
-                if (c == 'D') keyStates[KEY_RIGHT] = true;
-            } else if (c == 'w' || c == 'a' || c == 's' || c == 'd') {
-                if (c == 'w') keyStates[KEY_UP] = true;
-                if (c == 's') keyStates[KEY_DOWN] = true;
-                if (c == 'a') keyStates[KEY_LEFT] = true;
-                if (c == 'd') keyStates[KEY_RIGHT] = true;
+            if (pending() == 1) {
+                // A lone ESC is the Escape key unless the rest of a sequence
+                // is still on its way
+                if (moreComing) return;
+                InputEvent e = { InputEvent::QUIT, 0, 0, 0, 0, t };
+                push(e);
+                ringHead++;
+                continue;
+            }
+            size_t used = 0;
+            char kind = peek(1);
+            if (kind == '[') {
+                used = parseCsi(t);
+            } else if (kind == 'O') {
+                // SS3 arrows from application cursor mode
+                if (pending() < 3) return;
+                pushArrow(peek(2), false, t);
+                used = 3;
+            } else {
+                InputEvent e = { InputEvent::QUIT, 0, 0, 0, 0, t };
+                push(e);
+                used = 1;
             }
+            if (used == 0) {
+                // Incomplete; drop it if it can never finish
+                if (pending() >= RING_SIZE / 2) ringHead = ringTail;
+                return;
+            }
+            ringHead += used;
         }
-        
-        shiftPressed = newShift;
-#endif
     }
     
-    void processMovement(double& x, double& y) {
-        double speed = shiftPressed ? 4.0 : 2.0;
-        double speedX = shiftPressed ? 2.0 : 1.0;
+public:
+#ifdef _WIN32
+    bool wait(int timeoutMs) {
+        eventCount = eventRead = 0;
+        if (!_kbhit()) {
+            WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE), timeoutMs > 0 ? timeoutMs : 0);
+        }
+        auto t = std::chrono::steady_clock::now();
+        while (_kbhit()) {
+            int c = _getch();
+            if (c == 27) {
+                InputEvent e = { InputEvent::QUIT, 0, 0, 0, 0, t };
+                push(e);
+            } else if (c == 224 || c == 0) { // Arrow keys
+                c = _getch();
+                if (c == 72) pushArrow('A', false, t);
+                if (c == 80) pushArrow('B', false, t);
+                if (c == 77) pushArrow('C', false, t);
+                if (c == 75) pushArrow('D', false, t);
+            } else {
+                pushKey(static_cast<char>(c), t);
+            }
+        }
+        return eventCount > 0;
+    }
+#else
+    // Blocks until input arrives or timeoutMs passes, then reads everything
+    // available in one go and decodes it. Returns true if events are ready.
+    bool wait(int timeoutMs) {
+        eventCount = eventRead = 0;
+        struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+        if (poll(&pfd, 1, std::max(0, timeoutMs)) <= 0) return false;
         
-        if (keyStates[KEY_UP]) y -= speed;
-        if (keyStates[KEY_DOWN]) y += speed;
-        if (keyStates[KEY_LEFT]) x -= speedX;
-        if (keyStates[KEY_RIGHT]) x += speedX;
+        bool gotData = false;
+        for (;;) {
+            size_t space = RING_SIZE - pending();
+            if (space == 0) break;
+            size_t at = ringTail % RING_SIZE;
+            size_t chunk = std::min(space, RING_SIZE - at);
+            ssize_t n = read(STDIN_FILENO, ring + at, chunk);
+            if (n <= 0) break;
+            ringTail += n;
+            gotData = true;
+        }
+        if (!gotData) return false;
         
-        // Clear key states after processing
-        keyStates.clear();
+        auto t = std::chrono::steady_clock::now();
+        struct pollfd again = { STDIN_FILENO, POLLIN, 0 };
+        parse(t, poll(&again, 1, 0) > 0);
+        return eventCount > 0;
     }
+#endif
     
-    bool shouldQuit() {
-        return keyStates[KEY_QUIT];
+    bool next(InputEvent& e) {
+        if (eventRead >= eventCount) return false;
+        e = events[eventRead++];
+        return true;
     }
 };
 
@@ -447,14 +608,81 @@ private:
     bool running;
     InputManager input;
     bool sizeChanged;
+    Metrics metrics;
+    bool graphicsRequested;
+    GraphicsProtocol graphics;
+    size_t graphicsBudget;
+    int cellW, cellH;
+    bool colorModeForced;
+    Palette colors;
+    uint16_t cursorSlot;
+#ifndef _WIN32
+    FrameStreamer streamer;
+#endif
+    
+    // White background for pixel mode so tiles that go back to blank can
+    // simply be dropped
+    static const char* screenClear(GraphicsProtocol proto) {
+        return proto == GraphicsProtocol::None ? "\033[2J\033[H" : "\033[48;2;255;255;255m\033[2J\033[H";
+    }
+    
+    PixelCanvas* createPixelCanvas() const {
+        // Sixel leaves the cursor below the image, so an image touching the
+        // last row would scroll the screen; keep that row free.
+        int rows = graphics == GraphicsProtocol::Sixel ? termHeight - 1 : termHeight;
+        return new PixelCanvas(graphics, termWidth, std::max(1, rows), cellW, cellH);
+    }
+    
+    uint32_t countMovingPoints() const {
+        uint32_t moving = 0;
+        for (const auto& point : points) {
+            if (point.velocity.x != 0 || point.velocity.y != 0 || point.velocity.z != 0) moving++;
+        }
+        return moving;
+    }
     
 public:
-    App() : mousePos(0, 0, 0), termWidth(80), termHeight(24), running(true), sizeChanged(false) {}
+    App() : mousePos(0, 0, 0), termWidth(80), termHeight(24), running(true), sizeChanged(false),
+            graphicsRequested(false), graphics(GraphicsProtocol::None), graphicsBudget(128 * 1024),
+            cellW(0), cellH(0), colorModeForced(false), cursorSlot(palette::NONE) {}
+    
+    bool serve(const std::string& spec, std::string& error) {
+#ifdef _WIN32
+        error = "not supported on Windows";
+        return false;
+#else
+        return streamer.listen(spec, error);
+#endif
+    }
+    
+    void setColorMode(ColorMode mode) {
+        colors = Palette(mode);
+        colorModeForced = true;
+    }
+    
+    void enableMetrics(MetricsFormat format, const std::string& path) {
+        metrics.configure(format, path);
+    }
+    
+    // proto None means auto-detect
+    void enableGraphics(GraphicsProtocol proto, size_t budgetBytes) {
+        graphicsRequested = true;
+        graphics = proto;
+        graphicsBudget = budgetBytes;
+    }
     
     void init() {
         Terminal::setup();
         Terminal::getSize(termWidth, termHeight);
         
+        if (graphicsRequested) {
+            if (graphics == GraphicsProtocol::None) graphics = Terminal::detectGraphics();
+            if (graphics != GraphicsProtocol::None && !Terminal::getCellPixelSize(cellW, cellH)) {
+                cellW = 10;
+                cellH = 20;
+            }
+        }
+        
         // Cap terminal size to prevent performance issues
         const int MAX_WIDTH = 200;
         const int MAX_HEIGHT = 60;
@@ -497,10 +725,17 @@ public:
         for (const auto& data : pointData) {
             double x = offsetX + data.x * scale;
             double y = offsetY + data.y * scale;
-            double size = data.size * scale * 0.3;
+            double size = data.size * scale * CELL_BALL_SCALE;
             points.emplace_back(x, y, 0.0, size, data.color);
         }
         
+        // Quantize every colour once up front; rendering only indexes the table
+        if (!colorModeForced) colors = Palette(Palette::detect());
+        for (auto& point : points) {
+            point.colorSlot = colors.intern(point.color.r, point.color.g, point.color.b);
+        }
+        cursorSlot = colors.intern(128, 128, 128);
+        
         // Start mouse in center
         mousePos.x = termWidth / 2.0;
         mousePos.y = termHeight;
@@ -528,53 +763,69 @@ public:
     void render(TerminalCanvas& canvas) {
         canvas.clear();
         
-        // Debug: print some info at top
-        static int frameCount = 0;
-        if (frameCount++ % 30 == 0) {  // Every 30 frames
-            FILE* f = fopen("/tmp/balls_debug.txt", "a");
-            if (f) {
-                fprintf(f, "Mouse: %.1f,%.1f Term: %dx%d Points: %zu\n",
-                       mousePos.x, mousePos.y, termWidth, termHeight, points.size());
-                if (!points.empty()) {
-                    fprintf(f, "First point at: %.1f,%.1f\n", 
-                           points[0].curPos.x, points[0].curPos.y);
-                }
-                fclose(f);
-            }
-        }
-        
         for (auto& point : points) {
             // Adjust for terminal character aspect ratio (chars are ~2x taller than wide)
             canvas.drawCircle(
                 static_cast<int>(point.curPos.x),
                 static_cast<int>(point.curPos.y / 2.0),
                 point.radius * 0.5,
-                point.color
+                point.colorSlot
             );
         }
         
         // Draw cursor position
         int cx = static_cast<int>(mousePos.x);
         int cy = static_cast<int>(mousePos.y / 2.0);
-        canvas.setPixel(cx, cy, "✦", Color(128, 128, 128));
+        canvas.setPixel(cx, cy, "✦", cursorSlot);
     }
     
-    void run() {
-        FILE* f = fopen("/tmp/balls_debug.txt", "w");
-        if (f) {
-            fprintf(f, "Starting run() with termWidth=%d, termHeight=%d\n", termWidth, termHeight);
-            fclose(f);
+    void renderPixels(PixelCanvas& canvas) {
+        canvas.clear();
+        
+        // Simulation x is in columns and y in half rows
+        double sx = canvas.cellWidth();
+        double sy = canvas.cellHeight() / 2.0;
+        for (auto& point : points) {
+            canvas.drawDisc(point.curPos.x * sx, point.curPos.y * sy,
+                            point.radius / CELL_BALL_SCALE * sx,
+                            point.color.r, point.color.g, point.color.b);
         }
         
+        canvas.drawDisc(mousePos.x * sx, mousePos.y * sy, sx * 0.5, 128, 128, 128);
+    }
+    
+    void run() {
         std::unique_ptr<TerminalCanvas> canvas(new TerminalCanvas(termWidth, termHeight));
+        std::unique_ptr<PixelCanvas> pixelCanvas;
+        if (graphics != GraphicsProtocol::None) pixelCanvas.reset(createPixelCanvas());
         
         std::cout << "\033[2J\033[H"; // Clear and home
-        std::cout << "Google Balls Terminal Edition - Arrow keys/WASD to move | Hold Shift for speed boost | Q to quit\n" << std::flush;
+        std::cout << "Google Balls Terminal Edition - Mouse, arrow keys or WASD to move | Hold Shift for speed boost | Q to quit\n" << std::flush;
         std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        std::cout << screenClear(graphics) << std::flush;
         
-        auto lastFrame = std::chrono::steady_clock::now();
+        // Physics ticks every 30ms like the original
+        const auto tickInterval = std::chrono::milliseconds(30);
+        // Between ticks only the cursor moves; with any-motion tracking a
+        // mouse can report a thousand times a second, so those redraws are
+        // held to one per display refresh and the rest just move mousePos
+        const auto cursorInterval = std::chrono::milliseconds(16);
+        auto nextTick = std::chrono::steady_clock::now();
+        auto lastFrame = nextTick - cursorInterval;
+        bool cursorDirty = false;
+        auto runStart = nextTick;
+        auto prevFrameStart = nextTick;
+        uint64_t frameNumber = 0;
+        // Oldest input the balls haven't reacted to on screen yet
+        std::chrono::steady_clock::time_point pendingInput;
+        bool inputPending = false;
         
         while (running) {
+            if (g_metricsDumpRequested) {
+                g_metricsDumpRequested = 0;
+                metrics.dump();
+            }
+            
             // Cap terminal size to prevent performance issues
             const int MAX_WIDTH = 200;
             const int MAX_HEIGHT = 60;
@@ -593,47 +844,193 @@ public:
                 termWidth = newWidth;
                 termHeight = newHeight;
                 canvas.reset(new TerminalCanvas(termWidth, termHeight));
-                std::cout << "\033[2J\033[H" << std::flush; // Clear on resize
+                if (pixelCanvas) pixelCanvas.reset(createPixelCanvas());
+                std::cout << PixelCanvas::reset(graphics) << screenClear(graphics) << std::flush; // Clear on resize
             }
             
-            // Handle input
-            input.update();
-            
-            if (input.shouldQuit()) {
-                running = false;
-                break;
+            // Sleep until the next tick, but wake as soon as input lands so
+            // the cursor moves without waiting out the rest of the tick
+            auto now = std::chrono::steady_clock::now();
+            auto wakeAt = nextTick;
+            if (cursorDirty) wakeAt = std::min(wakeAt, lastFrame + cursorInterval);
+            int timeoutMs = 0;
+            if (wakeAt > now) {
+                auto us = std::chrono::duration_cast<std::chrono::microseconds>(wakeAt - now).count();
+                timeoutMs = static_cast<int>((us + 999) / 1000);
             }
             
-            input.processMovement(mousePos.x, mousePos.y);
+            if (input.wait(timeoutMs)) {
+                InputEvent e;
+                while (input.next(e)) {
+                    if (e.type == InputEvent::QUIT) {
+                        running = false;
+                        break;
+                    }
+                    if (e.type == InputEvent::MOVE) {
+                        mousePos.x += e.dx;
+                        mousePos.y += e.dy;
+                    } else {
+                        mousePos.x = e.col;
+                        mousePos.y = e.row * 2 + 1;
+                    }
+                    if (!inputPending || e.time < pendingInput) pendingInput = e.time;
+                    inputPending = true;
+                    cursorDirty = true;
+                }
+                if (!running) break;
+            }
             
             // Clamp mouse
             mousePos.x = std::max(0.0, std::min(static_cast<double>(termWidth - 1), mousePos.x));
             mousePos.y = std::max(0.0, std::min(static_cast<double>(termHeight * 2 - 1), mousePos.y));
             
-            update();
-            render(*canvas);
+            auto frameStart = std::chrono::steady_clock::now();
+            bool tick = frameStart >= nextTick;
+            bool cursorDue = cursorDirty && frameStart >= lastFrame + cursorInterval;
+            if (!tick && !cursorDue) continue;
+            cursorDirty = false;
+            lastFrame = frameStart;
             
-            std::cout << canvas->render() << std::flush;
+            if (tick) {
+                update();
+                nextTick += tickInterval;
+                if (nextTick <= frameStart) nextTick = frameStart + tickInterval; // fell behind
+            }
             
-            // Frame timing (30ms like original)
-            auto now = std::chrono::steady_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastFrame);
-            if (elapsed.count() < 30) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(30 - elapsed.count()));
+            std::string frame;
+            int changedCells;
+            if (pixelCanvas) {
+                renderPixels(*pixelCanvas);
+                pixelCanvas->encode(frame, graphicsBudget);
+                changedCells = pixelCanvas->lastChangedCells();
+            } else {
+                render(*canvas);
+                frame = canvas->render(colors, metrics.enabled());
+                changedCells = canvas->lastChangedCells();
             }
-            lastFrame = std::chrono::steady_clock::now();
+            std::cout << frame << std::flush;
+            
+#ifndef _WIN32
+            if (streamer.active()) {
+                // Viewers always get characters; pixel mode only drew pixels
+                if (pixelCanvas) render(*canvas);
+                streamer.publish(canvas->cells(), colors);
+            }
+#endif
+            
+            // The balls only react on a physics tick; frames that just move
+            // the cursor don't count as the input reaching the screen
+            uint64_t inputLatencyUs = 0;
+            if (tick && inputPending) {
+                auto written = std::chrono::steady_clock::now();
+                inputLatencyUs = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(written - pendingInput).count());
+                inputPending = false;
+            }
+            
+            if (metrics.enabled()) {
+                auto done = std::chrono::steady_clock::now();
+                FrameMetrics m;
+                m.frame = frameNumber;
+                m.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(frameStart - runStart).count();
+                m.frameMs = std::chrono::duration<double, std::milli>(frameStart - prevFrameStart).count();
+                m.workMs = std::chrono::duration<double, std::milli>(done - frameStart).count();
+                m.cellsChanged = static_cast<uint32_t>(changedCells);
+                m.bytesWritten = static_cast<uint32_t>(frame.size());
+                m.balls = static_cast<uint32_t>(points.size());
+                m.ballsMoving = countMovingPoints();
+                m.inputLatencyUs = inputLatencyUs;
+                metrics.record(m);
+            }
+            prevFrameStart = frameStart;
+            frameNumber++;
         }
     }
     
     void cleanup() {
+#ifndef _WIN32
+        streamer.stop();
+#endif
         Terminal::restore();
+        std::cout << PixelCanvas::reset(graphics) << "\033[0m";
         std::cout << "\033[2J\033[H"; // Clear screen
         std::cout << "buh bye\n";
+        if (metrics.enabled()) {
+            if (metrics.inputLatency().count()) metrics.inputLatency().print(stdout, "Input latency");
+            if (metrics.dump()) std::cout << "Metrics written to " << metrics.outputPath() << " and " << metrics.latencyPath() << "\n";
+            else std::cerr << "Failed to write metrics to " << metrics.outputPath() << "\n";
+        }
     }
 };
 
-int main() {
+static void printUsage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [--metrics=csv|json] [--metrics-file=PATH]\n"
+              << "       [--graphics[=auto|kitty|sixel]] [--graphics-budget=KB] [--colors=truecolor|256|16]\n"
+              << "       [--serve=unix:PATH|tcp:[HOST:]PORT]\n"
+              << "  --metrics=FORMAT       record per-frame metrics, written on exit or SIGUSR1\n"
+              << "  --metrics-file=PATH    where to write them (default balls-metrics.csv/.json); the input\n"
+              << "                         latency histogram goes next to it as <name>-latency.json\n"
+              << "  --graphics=PROTOCOL    draw real pixels with kitty graphics or sixel (default: detect)\n"
+              << "  --graphics-budget=KB   most bytes sent per frame in graphics mode (default 128)\n"
+              << "  --colors=DEPTH         colour depth for character output (default: from COLORTERM/TERM)\n"
+              << "  --serve=ADDRESS        stream frames to viewers connecting with nc/telnet (tcp defaults to 127.0.0.1)\n";
+}
+
+int main(int argc, char** argv) {
+    MetricsFormat metricsFormat = MetricsFormat::Off;
+    std::string metricsFile;
+    bool graphics = false;
+    GraphicsProtocol graphicsProtocol = GraphicsProtocol::None;
+    size_t graphicsBudget = 128 * 1024;
+    bool colorModeSet = false;
+    ColorMode colorMode = ColorMode::TrueColor;
+    std::string serveAddress;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--metrics" || arg == "--metrics=csv") {
+            metricsFormat = MetricsFormat::Csv;
+        } else if (arg == "--metrics=json") {
+            metricsFormat = MetricsFormat::Json;
+        } else if (arg.compare(0, 15, "--metrics-file=") == 0) {
+            metricsFile = arg.substr(15);
+        } else if (arg == "--graphics" || arg == "--graphics=auto") {
+            graphics = true;
+        } else if (arg == "--graphics=kitty") {
+            graphics = true;
+            graphicsProtocol = GraphicsProtocol::Kitty;
+        } else if (arg == "--graphics=sixel") {
+            graphics = true;
+            graphicsProtocol = GraphicsProtocol::Sixel;
+        } else if (arg.compare(0, 18, "--graphics-budget=") == 0 && std::atoi(arg.c_str() + 18) > 0) {
+            graphicsBudget = static_cast<size_t>(std::atoi(arg.c_str() + 18)) * 1024;
+        } else if (arg == "--colors=truecolor" || arg == "--colors=24bit") {
+            colorModeSet = true;
+            colorMode = ColorMode::TrueColor;
+        } else if (arg == "--colors=256") {
+            colorModeSet = true;
+            colorMode = ColorMode::Ansi256;
+        } else if (arg == "--colors=16") {
+            colorModeSet = true;
+            colorMode = ColorMode::Ansi16;
+        } else if (arg.compare(0, 8, "--serve=") == 0) {
+            serveAddress = arg.substr(8);
+        } else {
+            printUsage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+    
     App app;
+    app.enableMetrics(metricsFormat, metricsFile);
+    if (graphics) app.enableGraphics(graphicsProtocol, graphicsBudget);
+    if (colorModeSet) app.setColorMode(colorMode);
+    if (!serveAddress.empty()) {
+        std::string error;
+        if (!app.serve(serveAddress, error)) {
+            std::cerr << "Can't serve on " << serveAddress << ": " << error << "\n";
+            return 1;
+        }
+    }
     app.init();
     app.run();
     app.cleanup();
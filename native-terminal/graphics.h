@@ -0,0 +1,443 @@
+#ifndef GRAPHICS_H
+#define GRAPHICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Pixel output for terminals that can show images. The frame is rasterized
+// into an RGB framebuffer and cut into tiles of TILE_COLS x TILE_ROWS cells;
+// only tiles whose pixels differ from what the terminal already shows are
+// re-sent, and never more than the per-frame byte budget.
+
+enum class GraphicsProtocol { None, Kitty, Sixel };
+
+namespace gfx {
+
+static const uint32_t BACKGROUND = 0xFFFFFF;
+
+static const char BASE64_CHARS[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+inline void appendBase64(std::string& out, const uint8_t* data, size_t len) {
+    size_t i = 0;
+    for (; i + 2 < len; i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out += BASE64_CHARS[(v >> 18) & 63];
+        out += BASE64_CHARS[(v >> 12) & 63];
+        out += BASE64_CHARS[(v >> 6) & 63];
+        out += BASE64_CHARS[v & 63];
+    }
+    if (i < len) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < len) v |= data[i + 1] << 8;
+        out += BASE64_CHARS[(v >> 18) & 63];
+        out += BASE64_CHARS[(v >> 12) & 63];
+        out += i + 1 < len ? BASE64_CHARS[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+}
+
+// Minimal zlib stream writer using deflate's fixed Huffman block. The only
+// matches it looks for are "same as the previous pixel" and "same as the pixel
+// above", which is all run-length coding needs for a mostly white image and is
+// what kitty's o=z transmission accepts.
+class ZlibWriter {
+private:
+    std::vector<uint8_t>& out;
+    uint32_t bitBuf;
+    int bitCount;
+
+    void putBits(uint32_t value, int n) {
+        bitBuf |= value << bitCount;
+        bitCount += n;
+        while (bitCount >= 8) {
+            out.push_back(static_cast<uint8_t>(bitBuf & 0xFF));
+            bitBuf >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    // Huffman codes are defined MSB first but packed LSB first.
+    void putCode(uint32_t code, int n) {
+        uint32_t rev = 0;
+        for (int i = 0; i < n; i++) rev |= ((code >> i) & 1) << (n - 1 - i);
+        putBits(rev, n);
+    }
+
+    void putSymbol(int s) {
+        if (s < 144) putCode(0x30 + s, 8);
+        else if (s < 256) putCode(0x190 + (s - 144), 9);
+        else if (s < 280) putCode(s - 256, 7);
+        else putCode(0xC0 + (s - 280), 8);
+    }
+
+    void putMatch(int length, int distance) {
+        static const int lenBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int lenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const int distBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                         193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                         6145, 8193, 12289, 16385, 24577};
+        static const int distExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                          6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        int lc = 28;
+        while (lenBase[lc] > length) lc--;
+        putSymbol(257 + lc);
+        putBits(length - lenBase[lc], lenExtra[lc]);
+
+        int dc = 29;
+        while (distBase[dc] > distance) dc--;
+        putCode(dc, 5);
+        putBits(distance - distBase[dc], distExtra[dc]);
+    }
+
+    static int matchLength(const uint8_t* data, size_t pos, size_t len, size_t distance) {
+        if (distance == 0 || pos < distance) return 0;
+        size_t maxLen = std::min<size_t>(258, len - pos);
+        size_t n = 0;
+        while (n < maxLen && data[pos + n] == data[pos + n - distance]) n++;
+        return static_cast<int>(n);
+    }
+
+public:
+    explicit ZlibWriter(std::vector<uint8_t>& dst) : out(dst), bitBuf(0), bitCount(0) {}
+
+    // stride is the byte distance to the pixel above (0 to disable).
+    void compress(const uint8_t* data, size_t len, size_t pixelBytes, size_t stride) {
+        out.push_back(0x78);
+        out.push_back(0x01);
+        putBits(1, 1); // BFINAL
+        putBits(1, 2); // BTYPE = fixed Huffman
+
+        size_t pos = 0;
+        while (pos < len) {
+            int best = matchLength(data, pos, len, pixelBytes);
+            size_t bestDist = pixelBytes;
+            if (stride > 0 && stride <= 32768) {
+                int above = matchLength(data, pos, len, stride);
+                if (above > best) { best = above; bestDist = stride; }
+            }
+            if (best >= 3) {
+                putMatch(best, static_cast<int>(bestDist));
+                pos += best;
+            } else {
+                putSymbol(data[pos]);
+                pos++;
+            }
+        }
+        putSymbol(256);
+        if (bitCount > 0) putBits(0, 8 - bitCount);
+
+        uint32_t a = 1, b = 0;
+        for (size_t i = 0; i < len; i++) {
+            a = (a + data[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        uint32_t adler = (b << 16) | a;
+        out.push_back(static_cast<uint8_t>(adler >> 24));
+        out.push_back(static_cast<uint8_t>(adler >> 16));
+        out.push_back(static_cast<uint8_t>(adler >> 8));
+        out.push_back(static_cast<uint8_t>(adler));
+    }
+};
+
+} // namespace gfx
+
+class PixelCanvas {
+public:
+    static const int TILE_COLS = 8;
+    static const int TILE_ROWS = 4;
+
+private:
+    struct Rect { int x0, y0, x1, y1; }; // inclusive
+
+    GraphicsProtocol protocol;
+    int cols, rows;          // terminal cells covered
+    int cellW, cellH;
+    int width, height;       // pixels
+    int tileW, tileH, tilesX, tilesY;
+    std::vector<uint32_t> pixels;  // 0xRRGGBB
+    std::vector<uint32_t> shown;   // what the terminal currently has
+    std::vector<uint8_t> tileDirty;
+    std::vector<uint8_t> tileHasImage;
+    std::vector<Rect> drawnRects;
+    size_t nextTile;
+    int tilesSent;
+
+    // Scratch buffers reused between frames
+    std::vector<uint8_t> rgb;
+    std::vector<uint8_t> packed;
+    std::vector<uint8_t> indices;
+
+    void markTiles(const Rect& r) {
+        int tx0 = r.x0 / tileW, tx1 = r.x1 / tileW;
+        int ty0 = r.y0 / tileH, ty1 = r.y1 / tileH;
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++)
+                tileDirty[ty * tilesX + tx] = 1;
+    }
+
+    bool clipRect(Rect& r) const {
+        r.x0 = std::max(0, r.x0);
+        r.y0 = std::max(0, r.y0);
+        r.x1 = std::min(width - 1, r.x1);
+        r.y1 = std::min(height - 1, r.y1);
+        return r.x0 <= r.x1 && r.y0 <= r.y1;
+    }
+
+    void tileBounds(int tile, int& x0, int& y0, int& w, int& h) const {
+        x0 = (tile % tilesX) * tileW;
+        y0 = (tile / tilesX) * tileH;
+        w = std::min(tileW, width - x0);
+        h = std::min(tileH, height - y0);
+    }
+
+    bool tileMatchesShown(int x0, int y0, int w, int h) const {
+        for (int y = y0; y < y0 + h; y++) {
+            if (memcmp(&pixels[y * width + x0], &shown[y * width + x0], w * sizeof(uint32_t)) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    bool tileIsBackground(int x0, int y0, int w, int h) const {
+        for (int y = y0; y < y0 + h; y++)
+            for (int x = x0; x < x0 + w; x++)
+                if (pixels[y * width + x] != gfx::BACKGROUND) return false;
+        return true;
+    }
+
+    static void moveTo(std::string& out, int row, int col) {
+        out += "\033[" + std::to_string(row + 1) + ";" + std::to_string(col + 1) + "H";
+    }
+
+    void encodeKitty(std::string& out, int tile, int x0, int y0, int w, int h) {
+        int id = tile + 1;
+        if (tileIsBackground(x0, y0, w, h)) {
+            // The cells underneath are already painted white; just drop the image
+            if (tileHasImage[tile]) {
+                out += "\033_Ga=d,d=I,q=2,i=" + std::to_string(id) + "\033\\";
+                tileHasImage[tile] = 0;
+            }
+            return;
+        }
+
+        rgb.resize(static_cast<size_t>(w) * h * 3);
+        uint8_t* p = rgb.data();
+        for (int y = y0; y < y0 + h; y++) {
+            for (int x = x0; x < x0 + w; x++) {
+                uint32_t c = pixels[y * width + x];
+                *p++ = static_cast<uint8_t>(c >> 16);
+                *p++ = static_cast<uint8_t>(c >> 8);
+                *p++ = static_cast<uint8_t>(c);
+            }
+        }
+        packed.clear();
+        gfx::ZlibWriter(packed).compress(rgb.data(), rgb.size(), 3, static_cast<size_t>(w) * 3);
+
+        std::string payload;
+        gfx::appendBase64(payload, packed.data(), packed.size());
+
+        moveTo(out, y0 / cellH, x0 / cellW);
+        const size_t CHUNK = 4096;
+        for (size_t off = 0; off < payload.size(); off += CHUNK) {
+            bool more = off + CHUNK < payload.size();
+            out += "\033_G";
+            if (off == 0) {
+                out += "a=T,f=24,o=z,q=2,C=1,p=1,i=" + std::to_string(id) +
+                       ",s=" + std::to_string(w) + ",v=" + std::to_string(h) + ",";
+            }
+            out += more ? "m=1;" : "m=0;";
+            out.append(payload, off, std::min(CHUNK, payload.size() - off));
+            out += "\033\\";
+        }
+        tileHasImage[tile] = 1;
+    }
+
+    // Sixel palette is the 6x6x6 colour cube; index 215 is white.
+    static uint8_t quantize(uint32_t c) {
+        int r = (((c >> 16) & 0xFF) * 5 + 127) / 255;
+        int g = (((c >> 8) & 0xFF) * 5 + 127) / 255;
+        int b = ((c & 0xFF) * 5 + 127) / 255;
+        return static_cast<uint8_t>(r * 36 + g * 6 + b);
+    }
+
+    static void appendSixelRun(std::string& out, char c, int count) {
+        if (count > 3) {
+            out += '!';
+            out += std::to_string(count);
+            out += c;
+        } else {
+            out.append(count, c);
+        }
+    }
+
+    void encodeSixel(std::string& out, int x0, int y0, int w, int h) {
+        indices.resize(static_cast<size_t>(w) * h);
+        bool used[216] = {false};
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                uint8_t idx = quantize(pixels[(y0 + y) * width + x0 + x]);
+                indices[y * w + x] = idx;
+                used[idx] = true;
+            }
+        }
+
+        moveTo(out, y0 / cellH, x0 / cellW);
+        // P2=1: bits left at zero keep whatever is on screen, so a partial
+        // last band never spills into the tile below.
+        out += "\033P0;1;0q\"1;1;" + std::to_string(w) + ";" + std::to_string(h);
+        for (int i = 0; i < 216; i++) {
+            if (!used[i]) continue;
+            out += "#" + std::to_string(i) + ";2;" + std::to_string(i / 36 * 20) + ";" +
+                   std::to_string(i / 6 % 6 * 20) + ";" + std::to_string(i % 6 * 20);
+        }
+
+        for (int band = 0; band < h; band += 6) {
+            int bandH = std::min(6, h - band);
+            bool first = true;
+            for (int i = 0; i < 216; i++) {
+                if (!used[i]) continue;
+                // Build this colour's row and skip it if the band has none
+                bool any = false;
+                std::string row;
+                char runChar = 0;
+                int runLen = 0;
+                int pendingBlank = 0;
+                for (int x = 0; x < w; x++) {
+                    int bits = 0;
+                    for (int k = 0; k < bandH; k++)
+                        if (indices[(band + k) * w + x] == i) bits |= 1 << k;
+                    char c = static_cast<char>(63 + bits);
+                    if (c == runChar) { runLen++; continue; }
+                    if (runLen > 0) {
+                        if (runChar == '?') pendingBlank += runLen;
+                        else {
+                            if (pendingBlank) { appendSixelRun(row, '?', pendingBlank); pendingBlank = 0; }
+                            appendSixelRun(row, runChar, runLen);
+                            any = true;
+                        }
+                    }
+                    runChar = c;
+                    runLen = 1;
+                }
+                if (runLen > 0 && runChar != '?') {
+                    if (pendingBlank) appendSixelRun(row, '?', pendingBlank);
+                    appendSixelRun(row, runChar, runLen);
+                    any = true;
+                }
+                if (!any) continue;
+                if (!first) out += '$';
+                out += "#" + std::to_string(i);
+                out += row;
+                first = false;
+            }
+            if (band + 6 < h) out += '-';
+        }
+        out += "\033\\";
+    }
+
+public:
+    PixelCanvas(GraphicsProtocol proto, int cols, int rows, int cellW, int cellH)
+        : protocol(proto), cols(cols), rows(rows), cellW(cellW), cellH(cellH),
+          nextTile(0), tilesSent(0) {
+        width = cols * cellW;
+        height = rows * cellH;
+        tileW = TILE_COLS * cellW;
+        tileH = TILE_ROWS * cellH;
+        tilesX = (cols + TILE_COLS - 1) / TILE_COLS;
+        tilesY = (rows + TILE_ROWS - 1) / TILE_ROWS;
+        pixels.assign(static_cast<size_t>(width) * height, gfx::BACKGROUND);
+        shown.assign(static_cast<size_t>(width) * height, gfx::BACKGROUND);
+        tileDirty.assign(tilesX * tilesY, 0);
+        tileHasImage.assign(tilesX * tilesY, 0);
+    }
+
+    int pixelWidth() const { return width; }
+    int pixelHeight() const { return height; }
+    int cellWidth() const { return cellW; }
+    int cellHeight() const { return cellH; }
+
+    // Restores the background under everything drawn last frame.
+    void clear() {
+        for (const auto& r : drawnRects) {
+            for (int y = r.y0; y <= r.y1; y++)
+                std::fill(&pixels[y * width + r.x0], &pixels[y * width + r.x1] + 1, gfx::BACKGROUND);
+            markTiles(r);
+        }
+        drawnRects.clear();
+    }
+
+    // Anti-aliased disc in pixel coordinates.
+    void drawDisc(double cx, double cy, double r, uint8_t cr, uint8_t cg, uint8_t cb) {
+        Rect box = { static_cast<int>(std::floor(cx - r - 1)), static_cast<int>(std::floor(cy - r - 1)),
+                     static_cast<int>(std::ceil(cx + r + 1)), static_cast<int>(std::ceil(cy + r + 1)) };
+        if (!clipRect(box)) return;
+
+        for (int y = box.y0; y <= box.y1; y++) {
+            double dy = y + 0.5 - cy;
+            for (int x = box.x0; x <= box.x1; x++) {
+                double dx = x + 0.5 - cx;
+                double dist = std::sqrt(dx * dx + dy * dy);
+                double a;
+                if (dist < r - 0.5) a = 1.0;
+                else if (dist < r + 0.5) a = r + 0.5 - dist;
+                else continue;
+
+                uint32_t& px = pixels[y * width + x];
+                int bgR = (px >> 16) & 0xFF, bgG = (px >> 8) & 0xFF, bgB = px & 0xFF;
+                int outR = static_cast<int>(cr * a + bgR * (1.0 - a));
+                int outG = static_cast<int>(cg * a + bgG * (1.0 - a));
+                int outB = static_cast<int>(cb * a + bgB * (1.0 - a));
+                px = (outR << 16) | (outG << 8) | outB;
+            }
+        }
+        drawnRects.push_back(box);
+        markTiles(box);
+    }
+
+    // Appends escape sequences for changed tiles to out, stopping once
+    // budgetBytes is used up. Tiles that did not fit stay dirty and go out
+    // first next frame.
+    void encode(std::string& out, size_t budgetBytes) {
+        size_t start = out.size();
+        size_t count = tileDirty.size();
+        tilesSent = 0;
+        for (size_t n = 0; n < count; n++) {
+            size_t tile = (nextTile + n) % count;
+            if (!tileDirty[tile]) continue;
+            if (out.size() - start >= budgetBytes) {
+                nextTile = tile;
+                return;
+            }
+
+            int x0, y0, w, h;
+            tileBounds(static_cast<int>(tile), x0, y0, w, h);
+            tileDirty[tile] = 0;
+            if (tileMatchesShown(x0, y0, w, h)) continue;
+
+            if (protocol == GraphicsProtocol::Kitty) encodeKitty(out, static_cast<int>(tile), x0, y0, w, h);
+            else encodeSixel(out, x0, y0, w, h);
+
+            for (int y = y0; y < y0 + h; y++)
+                memcpy(&shown[y * width + x0], &pixels[y * width + x0], w * sizeof(uint32_t));
+            tilesSent++;
+        }
+        nextTile = 0;
+    }
+
+    // Cells covered by the tiles sent in the last encode().
+    int lastChangedCells() const { return tilesSent * TILE_COLS * TILE_ROWS; }
+
+    // Escape sequence that drops every image this canvas placed.
+    static std::string reset(GraphicsProtocol proto) {
+        return proto == GraphicsProtocol::Kitty ? "\033_Ga=d,d=A,q=2\033\\" : "";
+    }
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../native-common/latency.h"
+
+// One sample per rendered frame. Everything is plain data so a slot can be
+// copied out by the dumper without touching the frame loop.
+struct FrameMetrics {
+    uint64_t frame;
+    uint64_t timeUs;        // since App::run() started
+    double frameMs;         // wall time since the previous frame
+    double workMs;          // input + physics + render + write, excluding sleep
+    uint32_t cellsChanged;
+    uint32_t bytesWritten;
+    uint32_t balls;
+    uint32_t ballsMoving;
+    uint64_t inputLatencyUs; // oldest input this frame reacted to, until written; 0 if none
+};
+
+enum class MetricsFormat { Off, Csv, Json };
+
+// Fixed-size ring of the most recent frames. The frame loop is the only
+// writer; readers may run at any time and never block it. Each slot carries a
+// sequence number so a reader can tell when the writer lapped it mid-copy and
+// drop that sample instead of reporting a torn one.
+template <size_t Capacity>
+class MetricsRing {
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        FrameMetrics data;
+    };
+
+    Slot slots[Capacity];
+    std::atomic<uint64_t> head;
+
+public:
+    MetricsRing() : head(0) {
+        for (auto& slot : slots) slot.seq.store(0, std::memory_order_relaxed);
+    }
+
+    void push(const FrameMetrics& m) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[h % Capacity];
+        slot.seq.store(0, std::memory_order_release); // mark busy
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.data = m;
+        slot.seq.store(h + 1, std::memory_order_release);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Oldest to newest.
+    std::vector<FrameMetrics> snapshot() const {
+        std::vector<FrameMetrics> out;
+        uint64_t h = head.load(std::memory_order_acquire);
+        uint64_t first = h > Capacity ? h - Capacity : 0;
+        out.reserve(static_cast<size_t>(h - first));
+        for (uint64_t i = first; i < h; i++) {
+            const Slot& slot = slots[i % Capacity];
+            if (slot.seq.load(std::memory_order_acquire) != i + 1) continue;
+            FrameMetrics copy = slot.data;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != i + 1) continue;
+            out.push_back(copy);
+        }
+        return out;
+    }
+};
+
+class Metrics {
+private:
+    MetricsRing<4096> ring;
+    LatencyHistogram latency; // every frame since start, not just the ring
+    MetricsFormat format;
+    std::string path;
+
+    void writeCsv(FILE* f, const std::vector<FrameMetrics>& frames) const {
+        fprintf(f, "frame,time_us,frame_ms,work_ms,cells_changed,bytes_written,balls,balls_moving,input_latency_us\n");
+        for (const auto& m : frames) {
+            fprintf(f, "%llu,%llu,%.3f,%.3f,%u,%u,%u,%u,%llu\n",
+                    (unsigned long long)m.frame, (unsigned long long)m.timeUs,
+                    m.frameMs, m.workMs, m.cellsChanged, m.bytesWritten,
+                    m.balls, m.ballsMoving, (unsigned long long)m.inputLatencyUs);
+        }
+    }
+
+    void writeJson(FILE* f, const std::vector<FrameMetrics>& frames) const {
+        fprintf(f, "[\n");
+        for (size_t i = 0; i < frames.size(); i++) {
+            const auto& m = frames[i];
+            fprintf(f, "  {\"frame\": %llu, \"time_us\": %llu, \"frame_ms\": %.3f, \"work_ms\": %.3f, "
+                       "\"cells_changed\": %u, \"bytes_written\": %u, \"balls\": %u, \"balls_moving\": %u, "
+                       "\"input_latency_us\": %llu}%s\n",
+                    (unsigned long long)m.frame, (unsigned long long)m.timeUs,
+                    m.frameMs, m.workMs, m.cellsChanged, m.bytesWritten,
+                    m.balls, m.ballsMoving, (unsigned long long)m.inputLatencyUs,
+                    i + 1 < frames.size() ? "," : "");
+        }
+        fprintf(f, "]\n");
+    }
+
+public:
+    Metrics() : format(MetricsFormat::Off) {}
+
+    void configure(MetricsFormat fmt, const std::string& file) {
+        format = fmt;
+        path = file;
+        if (path.empty() && format != MetricsFormat::Off) {
+            path = format == MetricsFormat::Json ? "balls-metrics.json" : "balls-metrics.csv";
+        }
+    }
+
+    bool enabled() const { return format != MetricsFormat::Off; }
+
+    void record(const FrameMetrics& m) {
+        ring.push(m);
+        if (m.inputLatencyUs) latency.record(m.inputLatencyUs);
+    }
+
+    // Rewrites the output file with whatever is currently in the ring, and
+    // the latency histogram next to it.
+    bool dump() const {
+        if (!enabled()) return true;
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) return false;
+        std::vector<FrameMetrics> frames = ring.snapshot();
+        if (format == MetricsFormat::Json) writeJson(f, frames);
+        else writeCsv(f, frames);
+        fclose(f);
+
+        f = fopen(latencyPath().c_str(), "w");
+        if (!f) return false;
+        latency.writeJson(f);
+        fprintf(f, "\n");
+        fclose(f);
+        return true;
+    }
+
+    const std::string& outputPath() const { return path; }
+
+    // balls-metrics.csv -> balls-metrics-latency.json
+    std::string latencyPath() const {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+        return path.substr(0, dot) + "-latency.json";
+    }
+
+    const LatencyHistogram& inputLatency() const { return latency; }
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// How many colours the terminal can show. Colours are quantized once when
+// they are registered with the Palette, so the frame loop only ever copies
+// prebuilt escape strings.
+enum class ColorMode { TrueColor, Ansi256, Ansi16 };
+
+namespace palette {
+
+// Slot value for cells that have no colour (blank)
+static const uint16_t NONE = 0xFFFF;
+
+struct Rgb { int r, g, b; };
+
+inline int distance(const Rgb& a, const Rgb& b) {
+    int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+    return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+}
+
+// xterm's default 16 colours
+static const Rgb ANSI16[16] = {
+    {0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0},
+    {0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+    {92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255}
+};
+
+inline int nearest16(const Rgb& c) {
+    int best = 0;
+    for (int i = 1; i < 16; i++) {
+        if (distance(c, ANSI16[i]) < distance(c, ANSI16[best])) best = i;
+    }
+    return best;
+}
+
+inline int cubeLevel(int v) {
+    if (v < 48) return 0;
+    if (v < 115) return 1;
+    return (v - 35) / 40;
+}
+
+// Best of the 6x6x6 cube (16..231) and the grey ramp (232..255).
+inline int nearest256(const Rgb& c) {
+    static const int LEVELS[6] = {0, 95, 135, 175, 215, 255};
+    int r = cubeLevel(c.r), g = cubeLevel(c.g), b = cubeLevel(c.b);
+    Rgb cube = {LEVELS[r], LEVELS[g], LEVELS[b]};
+
+    int avg = (c.r + c.g + c.b) / 3;
+    int grey = avg > 238 ? 23 : (avg < 8 ? 0 : (avg - 8) / 10);
+    int gv = 8 + grey * 10;
+    Rgb ramp = {gv, gv, gv};
+
+    if (distance(c, ramp) < distance(c, cube)) return 232 + grey;
+    return 16 + r * 36 + g * 6 + b;
+}
+
+} // namespace palette
+
+class Palette {
+private:
+    ColorMode mode;
+    std::vector<std::string> escapes;
+
+    std::string buildEscape(int r, int g, int b) const {
+        palette::Rgb c = {r, g, b};
+        switch (mode) {
+        case ColorMode::Ansi256:
+            return "\033[38;5;" + std::to_string(palette::nearest256(c)) + "m";
+        case ColorMode::Ansi16: {
+            int idx = palette::nearest16(c);
+            return "\033[" + std::to_string(idx < 8 ? 30 + idx : 90 + idx - 8) + "m";
+        }
+        default:
+            return "\033[38;2;" + std::to_string(r) + ";" + std::to_string(g) + ";" + std::to_string(b) + "m";
+        }
+    }
+
+public:
+    explicit Palette(ColorMode mode = ColorMode::TrueColor) : mode(mode) {}
+
+    ColorMode colorMode() const { return mode; }
+
+    // Returns the slot for a colour. Colours that quantize to the same escape
+    // share a slot, so comparing slots is enough to skip redundant escapes.
+    uint16_t intern(int r, int g, int b) {
+        std::string esc = buildEscape(r, g, b);
+        for (size_t i = 0; i < escapes.size(); i++) {
+            if (escapes[i] == esc) return static_cast<uint16_t>(i);
+        }
+        escapes.push_back(esc);
+        return static_cast<uint16_t>(escapes.size() - 1);
+    }
+
+    const std::string& escape(uint16_t slot) const { return escapes[slot]; }
+
+    static ColorMode detect() {
+        const char* colorterm = getenv("COLORTERM");
+        if (colorterm && (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0)) {
+            return ColorMode::TrueColor;
+        }
+        const char* term = getenv("TERM");
+        if (term) {
+            if (strstr(term, "direct")) return ColorMode::TrueColor;
+            if (strstr(term, "256color")) return ColorMode::Ansi256;
+        }
+#ifdef _WIN32
+        // Windows Terminal and conhost with VT processing both do 24-bit
+        return ColorMode::TrueColor;
+#else
+        return ColorMode::Ansi16;
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only view of a rendered character frame, shared by every viewer.
+struct CellFrame {
+    int width, height;
+    const std::vector<std::string>* glyphs;   // one string per row
+    const std::vector<uint16_t>* slots;       // Palette slot per cell
+};
+
+#ifndef _WIN32
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "palette.h"
+
+// Streams the character canvas to any number of viewers connected over a
+// Unix or TCP socket (plain nc/telnet works). The frame is rendered once; each
+// viewer gets a diff against the last frame it fully received. A viewer whose
+// previous diff is still in flight skips frames until it drains, so a slow
+// connection never holds up the simulation or the other viewers.
+class FrameStreamer {
+private:
+    struct Viewer {
+        int fd;
+        std::vector<char> shownGlyphs;
+        std::vector<uint16_t> shownSlots;
+        std::string outbox;
+        size_t outboxSent;
+        uint64_t framesSent;
+        uint64_t framesDropped;
+    };
+
+    int listenFd;
+    std::string unixPath;
+    int width, height;
+    std::vector<Viewer> viewers;
+
+    static bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    void resetViewer(Viewer& v) {
+        v.shownGlyphs.assign(static_cast<size_t>(width) * height, ' ');
+        v.shownSlots.assign(static_cast<size_t>(width) * height, palette::NONE);
+        v.outbox += "\033[0m\033[?25l\033[2J\033[H";
+    }
+
+    void acceptViewers() {
+        for (;;) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) return;
+            if (!setNonBlocking(fd)) {
+                close(fd);
+                continue;
+            }
+            Viewer v;
+            v.fd = fd;
+            v.outboxSent = 0;
+            v.framesSent = 0;
+            v.framesDropped = 0;
+            resetViewer(v);
+            viewers.push_back(v);
+        }
+    }
+
+    // Returns false once the viewer has gone away.
+    static bool flush(Viewer& v) {
+        while (v.outboxSent < v.outbox.size()) {
+            ssize_t n = send(v.fd, v.outbox.data() + v.outboxSent, v.outbox.size() - v.outboxSent, 0);
+            if (n > 0) {
+                v.outboxSent += n;
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        v.outbox.clear();
+        v.outboxSent = 0;
+        return true;
+    }
+
+    // Viewers may type (telnet negotiation, stray keys); throw it away and
+    // notice when they hang up.
+    static bool drainInput(Viewer& v) {
+        char buf[256];
+        for (;;) {
+            ssize_t n = recv(v.fd, buf, sizeof(buf), 0);
+            if (n > 0) continue;
+            if (n == 0) return false;
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+    }
+
+    static void appendDiff(Viewer& v, const CellFrame& frame, const Palette& colors) {
+        std::string& out = v.outbox;
+        int cursorX = -1, cursorY = -1;
+        uint16_t pen = palette::NONE;
+        bool penKnown = false;
+        for (int y = 0; y < frame.height; y++) {
+            const std::string& row = (*frame.glyphs)[y];
+            for (int x = 0; x < frame.width; x++) {
+                size_t idx = static_cast<size_t>(y) * frame.width + x;
+                char glyph = row[x];
+                uint16_t slot = glyph == ' ' ? palette::NONE : (*frame.slots)[idx];
+                if (glyph == v.shownGlyphs[idx] && slot == v.shownSlots[idx]) continue;
+
+                if (cursorX != x || cursorY != y) {
+                    out += "\033[" + std::to_string(y + 1) + ";" + std::to_string(x + 1) + "H";
+                }
+                if (slot != palette::NONE && (!penKnown || slot != pen)) {
+                    out += colors.escape(slot);
+                    pen = slot;
+                    penKnown = true;
+                }
+                out += glyph;
+                cursorX = x + 1;
+                cursorY = y;
+                v.shownGlyphs[idx] = glyph;
+                v.shownSlots[idx] = slot;
+            }
+        }
+    }
+
+public:
+    FrameStreamer() : listenFd(-1), width(0), height(0) {}
+
+    ~FrameStreamer() { stop(); }
+
+    bool active() const { return listenFd >= 0; }
+    size_t viewerCount() const { return viewers.size(); }
+
+    // spec is "unix:/path/to.sock", "tcp:PORT" (loopback) or "tcp:HOST:PORT".
+    bool listen(const std::string& spec, std::string& error) {
+        // A viewer hanging up mid-write must not kill the process
+        signal(SIGPIPE, SIG_IGN);
+
+        if (spec.compare(0, 5, "unix:") == 0) {
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            std::string path = spec.substr(5);
+            if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                error = "bad socket path";
+                return false;
+            }
+            strcpy(addr.sun_path, path.c_str());
+            listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listenFd < 0) { error = strerror(errno); return false; }
+            // Replace a stale socket from an earlier run, but nothing else
+            struct stat st;
+            if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str());
+            if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+                error = strerror(errno);
+                stop();
+                return false;
+            }
+            unixPath = path;
+        } else if (spec.compare(0, 4, "tcp:") == 0) {
+            std::string rest = spec.substr(4);
+            std::string host = "127.0.0.1";
+            size_t colon = rest.rfind(':');
+            if (colon != std::string::npos) {
+                host = rest.substr(0, colon);
+                rest = rest.substr(colon + 1);
+            }
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<uint16_t>(atoi(rest.c_str())));
+            if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 || addr.sin_port == 0) {
+                error = "bad address";
+                return false;
+            }
+            listenFd = socket(AF_INET, SOCK_STREAM, 0);
+            if (listenFd < 0) { error = strerror(errno); return false; }
+            int one = 1;
+            setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+                error = strerror(errno);
+                stop();
+                return false;
+            }
+        } else {
+            error = "expected unix:PATH or tcp:[HOST:]PORT";
+            return false;
+        }
+
+        if (::listen(listenFd, 16) < 0 || !setNonBlocking(listenFd)) {
+            error = strerror(errno);
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        for (auto& v : viewers) {
+            v.outbox = "\033[0m\033[?25h\033[2J\033[H";
+            v.outboxSent = 0;
+            flush(v);
+            close(v.fd);
+        }
+        viewers.clear();
+        if (listenFd >= 0) close(listenFd);
+        listenFd = -1;
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+        unixPath.clear();
+    }
+
+    // Called once per rendered frame. Never blocks.
+    void publish(const CellFrame& frame, const Palette& colors) {
+        if (!active()) return;
+        acceptViewers();
+
+        bool resized = frame.width != width || frame.height != height;
+        width = frame.width;
+        height = frame.height;
+
+        for (size_t i = 0; i < viewers.size();) {
+            Viewer& v = viewers[i];
+            if (resized) resetViewer(v);
+            bool alive = drainInput(v) && flush(v);
+            if (alive && v.outbox.empty()) {
+                appendDiff(v, frame, colors);
+                v.framesSent++;
+                alive = flush(v);
+            } else if (alive) {
+                // Still sending an older frame; this one is skipped and the
+                // next diff is taken against what the viewer actually has
+                v.framesDropped++;
+            }
+            if (!alive) {
+                close(v.fd);
+                viewers.erase(viewers.begin() + i);
+                continue;
+            }
+            i++;
+        }
+    }
+};
+
+#endif
+
+#endif
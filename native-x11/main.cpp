@@ -0,0 +1,512 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#ifdef HAVE_XPRESENT
+#include <X11/extensions/Xpresent.h>
+#endif
+#include <vector>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#include "../native-common/latency.h"
+#include "../native-common/tiled_raster.h"
+#include "../native-common/simulation_thread.h"
+
+static Display *display;
+static Window window;
+static GC gc;
+static Visual *visual;
+static int depth;
+static Atom wm_delete_window;
+
+static int width = 800, height = 600;
+static bool running = true;
+
+// Motion events queue every sample; the physics tick drains them
+static InputQueue<1024> inputQueue;
+
+// Physics runs on its own thread, which sleeps while everything is at rest.
+// Each tick it publishes a snapshot and bumps sim_fd; frames draw the newest.
+static const int physics_step_ms = 30;
+static SimulationThread *simulation;
+static int sim_fd = -1;
+static uint64_t last_tick_us = 0;
+static bool animating = false;
+
+// The frame lives in one XImage for the life of the window (until a resize).
+// With MIT-SHM it sits in a segment the server reads straight from, so a put
+// is a short request instead of the whole frame going down the socket. The
+// server tells us with ShmCompletion when it's done reading, and until then
+// the image isn't touched.
+static XImage *image;
+static XShmSegmentInfo shm_info;
+static bool allow_shm = true; // --no-shm turns it off, to compare
+static bool use_shm = false;
+static bool attach_failed = false;
+static int shm_completion_event = -1;
+static bool image_stale = true;   // window size changed since the image was made
+static bool put_in_flight = false;
+
+// Only what changed since the last frame is drawn and put: the old and new
+// spots of every ball that moved, plus whatever the server asked us to
+// repaint. The image still holds the rest from last time.
+struct Rect { int x0, y0, x1, y1; };
+static const size_t max_damage_rects = 16;
+static std::vector<Rect> damage;       // redrawn and put
+static std::vector<Rect> expose_rects; // only put again, the image is still good
+static bool full_redraw = true;
+
+// With the Present extension, frames are paced off vblank: after each put we
+// ask to be told about the next one (PresentNotifyMSC) and draw again then,
+// interpolating between ticks. Without it frames just follow the ticks.
+// This only paces: the put itself still goes to the window whenever the
+// server gets to it, not at vblank, so without a compositing manager a frame
+// can tear. Presenting a pixmap with PresentPixmap would fix that.
+#ifdef HAVE_XPRESENT
+static int present_opcode = -1;
+static uint32_t present_serial = 0;
+#endif
+static bool use_present = false;
+static bool vblank_pending = false;
+
+// With --latency, input-to-photon percentiles are printed on exit. A frame
+// counts as on screen at the vblank after its put with Present, or when the
+// server is done with the put without it.
+static bool report_latency = false;
+static InputLatency latency;
+
+static PointCollection pointCollection; // owned by the simulation thread
+static TiledRasterizer *rasterizer;
+static std::vector<raster::Disc> discs;
+static double logo_width, logo_height; // layout size, for centring the view
+static std::vector<raster::Disc> drawn_discs; // what the image holds now
+static std::vector<raster::Disc> rect_discs;
+static bool redraw_needed = true;
+
+static uint64_t get_time_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void wake_physics() {
+    simulation->wake();
+}
+
+
+static int catch_attach_error(Display *, XErrorEvent *) {
+    // BadAccess from XShmAttach: the server can't see our segment (it's on
+    // another machine, or in another IPC namespace)
+    attach_failed = true;
+    return 0;
+}
+
+static void destroy_image() {
+    if (!image) return;
+    if (use_shm) {
+        XShmDetach(display, &shm_info);
+        image->data = NULL;
+        XDestroyImage(image);
+        shmdt(shm_info.shmaddr);
+    } else {
+        XDestroyImage(image); // frees the pixels too
+    }
+    image = NULL;
+}
+
+static bool create_shm_image() {
+    image = XShmCreateImage(display, visual, depth, ZPixmap, NULL, &shm_info, width, height);
+    if (!image) return false;
+    shm_info.shmid = shmget(IPC_PRIVATE, (size_t)image->bytes_per_line * image->height, IPC_CREAT | 0600);
+    if (shm_info.shmid >= 0) {
+        shm_info.shmaddr = image->data = (char*)shmat(shm_info.shmid, NULL, 0);
+        shm_info.readOnly = False;
+        if (shm_info.shmaddr != (char*)-1) {
+            attach_failed = false;
+            XErrorHandler old_handler = XSetErrorHandler(catch_attach_error);
+            XShmAttach(display, &shm_info);
+            // The one round trip per image: the attach has to be known good
+            // before the segment goes away
+            XSync(display, False);
+            XSetErrorHandler(old_handler);
+            // Once both sides are attached the segment can be marked for
+            // removal, so it doesn't outlive us if we crash
+            shmctl(shm_info.shmid, IPC_RMID, NULL);
+            if (!attach_failed) return true;
+            shmdt(shm_info.shmaddr);
+        } else {
+            shmctl(shm_info.shmid, IPC_RMID, NULL);
+        }
+    }
+    image->data = NULL;
+    XDestroyImage(image);
+    image = NULL;
+    return false;
+}
+
+static bool create_image() {
+    destroy_image();
+    if (use_shm && !create_shm_image()) {
+        fprintf(stderr, "MIT-SHM didn't work, sending frames over the socket instead\n");
+        use_shm = false;
+    }
+    if (!use_shm) {
+        image = XCreateImage(display, visual, depth, ZPixmap, 0, NULL, width, height, 32, 0);
+        if (!image) return false;
+        image->data = (char*)malloc((size_t)image->bytes_per_line * height);
+        if (!image->data) {
+            XDestroyImage(image);
+            image = NULL;
+            return false;
+        }
+    }
+    // The rasterizer writes native-endian 0xAARRGGBB words
+    static const int native_order = *(const unsigned char*)"\1\0\0\0" ? LSBFirst : MSBFirst;
+    if (image->bits_per_pixel != 32 || image->byte_order != native_order) {
+        fprintf(stderr, "Unsupported image format: %d bits per pixel\n", image->bits_per_pixel);
+        destroy_image();
+        return false;
+    }
+    image_stale = false;
+    full_redraw = true;
+    expose_rects.clear();
+    drawn_discs.clear();
+    return true;
+}
+
+static void add_rect(std::vector<Rect>& rects, Rect r) {
+    r.x0 = std::max(r.x0, 0);
+    r.y0 = std::max(r.y0, 0);
+    r.x1 = std::min(r.x1, width);
+    r.y1 = std::min(r.y1, height);
+    if (r.x0 >= r.x1 || r.y0 >= r.y1) return;
+    // Overlapping rects are merged so nothing is drawn twice
+    for (size_t i = 0; i < rects.size();) {
+        const Rect& o = rects[i];
+        if (o.x0 < r.x1 && r.x0 < o.x1 && o.y0 < r.y1 && r.y0 < o.y1) {
+            r.x0 = std::min(r.x0, o.x0);
+            r.y0 = std::min(r.y0, o.y0);
+            r.x1 = std::max(r.x1, o.x1);
+            r.y1 = std::max(r.y1, o.y1);
+            rects.erase(rects.begin() + i);
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    rects.push_back(r);
+    // Past a handful the per-put overhead costs more than the extra pixels
+    if (rects.size() > max_damage_rects) {
+        Rect all = rects[0];
+        for (const Rect& o : rects) {
+            all.x0 = std::min(all.x0, o.x0);
+            all.y0 = std::min(all.y0, o.y0);
+            all.x1 = std::max(all.x1, o.x1);
+            all.y1 = std::max(all.y1, o.y1);
+        }
+        rects.assign(1, all);
+    }
+}
+
+static Rect disc_rect(const raster::Disc& d) {
+    float reach = d.r + 1.0f;
+    Rect r = { (int)std::floor(d.x - reach), (int)std::floor(d.y - reach),
+               (int)std::ceil(d.x + reach) + 1, (int)std::ceil(d.y + reach) + 1 };
+    return r;
+}
+
+static bool same_disc(const raster::Disc& a, const raster::Disc& b) {
+    return a.x == b.x && a.y == b.y && a.r == b.r && a.argb == b.argb;
+}
+
+static void initPoints() {
+    std::vector<PointData> pointData = logoPoints();
+    
+    computeBounds(pointData, logo_width, logo_height);
+    ViewTransform view = ViewTransform::centered(logo_width, logo_height, width, height);
+
+    // The points are built on the thread that owns them, in logo coordinates
+    simulation->post([pointData, view](PointCollection& points) {
+        points.points.clear();
+        for (const auto& data : pointData) {
+            points.addPoint(data.x, data.y, 0.0, static_cast<double>(data.size), data.color);
+        }
+        points.setView(view);
+    });
+}
+
+// Recentres the logo after a resize. Only the view changes, so this costs
+// the same for any number of balls and they keep moving as they were.
+static void update_view() {
+    ViewTransform view = ViewTransform::centered(logo_width, logo_height, width, height);
+    simulation->post([view](PointCollection& points) { points.setView(view); });
+}
+
+static void put_rect(const Rect& r, bool last) {
+    int w = r.x1 - r.x0, h = r.y1 - r.y0;
+    // Only the last put asks for ShmCompletion; the server handles them in
+    // order, so that one means the image is free again
+    if (use_shm) XShmPutImage(display, window, gc, image, r.x0, r.y0, r.x0, r.y0, w, h, last);
+    else XPutImage(display, window, gc, image, r.x0, r.y0, r.x0, r.y0, w, h);
+}
+
+static void draw_frame() {
+    if (image_stale && !create_image()) {
+        running = false;
+        return;
+    }
+
+    double alpha = 1.0;
+    if (use_present && animating) alpha = std::min(1.0, (double)(get_time_us() - last_tick_us) / (physics_step_ms * 1000.0));
+    simulation->snapshot().collectDiscs(discs, alpha, 1.0);
+
+    if (full_redraw || discs.size() != drawn_discs.size()) {
+        damage.clear();
+        add_rect(damage, Rect{ 0, 0, width, height });
+        full_redraw = false;
+    } else {
+        for (size_t i = 0; i < discs.size(); i++) {
+            if (same_disc(discs[i], drawn_discs[i])) continue;
+            add_rect(damage, disc_rect(drawn_discs[i]));
+            add_rect(damage, disc_rect(discs[i]));
+        }
+    }
+
+    uint32_t *pixels = (uint32_t*)image->data;
+    int stride = image->bytes_per_line / 4;
+    for (const Rect& r : damage) {
+        // Every ball touching the rect is drawn again, clipped to it, in the
+        // usual order, so overlaps come out the same as a full redraw
+        rect_discs.clear();
+        for (const raster::Disc& d : discs) {
+            Rect b = disc_rect(d);
+            if (b.x1 <= r.x0 || b.x0 >= r.x1 || b.y1 <= r.y0 || b.y0 >= r.y1) continue;
+            raster::Disc moved = d;
+            moved.x -= r.x0;
+            moved.y -= r.y0;
+            rect_discs.push_back(moved);
+        }
+        raster::Target target = { pixels + (size_t)r.y0 * stride + r.x0, stride, r.x1 - r.x0, r.y1 - r.y0 };
+        rasterizer->render(target, 0xFFFFFFFF, rect_discs);
+        add_rect(expose_rects, r);
+    }
+    damage.clear();
+    drawn_discs.swap(discs);
+    redraw_needed = false;
+
+    if (expose_rects.empty()) return;
+    for (size_t i = 0; i < expose_rects.size(); i++) put_rect(expose_rects[i], i + 1 == expose_rects.size());
+    expose_rects.clear();
+    put_in_flight = use_shm;
+    latency.frameSubmitted();
+
+#ifdef HAVE_XPRESENT
+    if (use_present) {
+        XPresentNotifyMSC(display, window, ++present_serial, 0, 1, 0);
+        vblank_pending = true;
+        return;
+    }
+#endif
+    if (!use_shm) latency.presented(InputLatency::nowUs());
+}
+
+static void handle_event(XEvent& event) {
+    switch (event.type) {
+    case MotionNotify:
+        inputQueue.push(event.xmotion.x, event.xmotion.y);
+        wake_physics();
+        break;
+    case EnterNotify:
+        inputQueue.push(event.xcrossing.x, event.xcrossing.y);
+        wake_physics();
+        break;
+    case LeaveNotify:
+        // A mouse that left stops pushing, or the next enter would sweep a
+        // line from where it went out
+        inputQueue.release(0);
+        wake_physics();
+        break;
+    case ConfigureNotify:
+        if (event.xconfigure.width != width || event.xconfigure.height != height) {
+            width = event.xconfigure.width;
+            height = event.xconfigure.height;
+            image_stale = true;
+            redraw_needed = true;
+            update_view();
+        }
+        break;
+    case Expose:
+        add_rect(expose_rects, Rect{ event.xexpose.x, event.xexpose.y,
+                                     event.xexpose.x + event.xexpose.width, event.xexpose.y + event.xexpose.height });
+        redraw_needed = true;
+        break;
+    case ClientMessage:
+        if ((Atom)event.xclient.data.l[0] == wm_delete_window) running = false;
+        break;
+#ifdef HAVE_XPRESENT
+    case GenericEvent:
+        if (event.xcookie.extension != present_opcode || !XGetEventData(display, &event.xcookie)) break;
+        if (event.xcookie.evtype == PresentCompleteNotify) {
+            XPresentCompleteNotifyEvent *complete = (XPresentCompleteNotifyEvent*)event.xcookie.data;
+            if (complete->serial_number == present_serial) {
+                vblank_pending = false;
+                // ust is CLOCK_MONOTONIC microseconds, like InputLatency::nowUs()
+                latency.presented(complete->ust);
+                if (animating) redraw_needed = true;
+            }
+        }
+        XFreeEventData(display, &event.xcookie);
+        break;
+#endif
+    default:
+        if (event.type == shm_completion_event) {
+            put_in_flight = false;
+            if (!use_present) latency.presented(InputLatency::nowUs());
+        }
+        break;
+    }
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--latency") == 0) {
+            report_latency = true;
+        } else if (strcmp(argv[i], "--no-shm") == 0) {
+            allow_shm = false;
+        } else {
+            fprintf(stderr, "usage: %s [--latency] [--no-shm]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Signals are read from a signalfd in the main loop. They have to be
+    // blocked before any thread exists, which includes the rasterizer's.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    sim_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (signal_fd < 0 || sim_fd < 0) { fprintf(stderr, "Failed to create signal or event fd: %m\n"); return 1; }
+
+    display = XOpenDisplay(NULL);
+    if (!display) { fprintf(stderr, "Failed to open X display\n"); return 1; }
+
+    int screen = DefaultScreen(display);
+    visual = DefaultVisual(display, screen);
+    depth = DefaultDepth(display, screen);
+    if (visual->c_class != TrueColor || visual->red_mask != 0xff0000 || visual->green_mask != 0xff00 || visual->blue_mask != 0xff) {
+        fprintf(stderr, "Needs a 24-bit TrueColor visual\n");
+        return 1;
+    }
+
+    if (allow_shm && XShmQueryExtension(display)) {
+        use_shm = true;
+        shm_completion_event = XShmGetEventBase(display) + ShmCompletion;
+    }
+
+    XSetWindowAttributes attributes;
+    attributes.background_pixel = WhitePixel(display, screen);
+    attributes.event_mask = PointerMotionMask | EnterWindowMask | LeaveWindowMask | StructureNotifyMask | ExposureMask;
+    window = XCreateWindow(display, RootWindow(display, screen), 0, 0, width, height, 0, depth, InputOutput,
+                           visual, CWBackPixel | CWEventMask, &attributes);
+    XStoreName(display, window, "Google Balls");
+    XClassHint class_hint = { (char*)"google-balls-x11", (char*)"google-balls-x11" };
+    XSetClassHint(display, window, &class_hint);
+    wm_delete_window = XInternAtom(display, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(display, window, &wm_delete_window, 1);
+    gc = XCreateGC(display, window, 0, NULL);
+
+#ifdef HAVE_XPRESENT
+    int present_event, present_error;
+    if (XPresentQueryExtension(display, &present_opcode, &present_event, &present_error)) {
+        XPresentSelectInput(display, window, PresentCompleteNotifyMask);
+        use_present = true;
+    }
+#endif
+
+    TiledRasterizer frame_rasterizer;
+    rasterizer = &frame_rasterizer;
+
+    SimulationThread physics(pointCollection, inputQueue, physics_step_ms * 1000);
+    simulation = &physics;
+    physics.start([]() {
+        // Can only fail once the counter is saturated, and then it's set anyway
+        uint64_t one = 1;
+        ssize_t written = write(sim_fd, &one, sizeof(one));
+        (void)written;
+    });
+    initPoints();
+
+    XMapWindow(display, window);
+
+    struct pollfd fds[3];
+    fds[0].fd = ConnectionNumber(display);
+    fds[1].fd = sim_fd;
+    fds[2].fd = signal_fd;
+    fds[0].events = fds[1].events = fds[2].events = POLLIN;
+
+    wake_physics();
+
+    while (running) {
+        while (XPending(display)) {
+            XEvent event;
+            XNextEvent(display, &event);
+            handle_event(event);
+        }
+
+        if (redraw_needed && !put_in_flight && !vblank_pending) draw_frame();
+        XFlush(display);
+        // Replies read while sending (the attach's XSync) can queue events
+        // without the socket being readable again
+        if (XEventsQueued(display, QueuedAlready)) continue;
+
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[2].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) running = false;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t ticks;
+            uint64_t input_us;
+            if (read(sim_fd, &ticks, sizeof(ticks)) == sizeof(ticks) && simulation->acquire(input_us)) {
+                if (input_us) latency.consumed(input_us);
+                // steady_clock is CLOCK_MONOTONIC here, like get_time_us()
+                last_tick_us = simulation->snapshot().tickUs;
+                animating = simulation->snapshot().moving;
+                redraw_needed = true;
+            }
+        }
+    }
+
+    physics.stop();
+    destroy_image();
+    XFreeGC(display, gc);
+    XDestroyWindow(display, window);
+    XCloseDisplay(display);
+    close(sim_fd);
+    close(signal_fd);
+    if (report_latency) latency.print(stdout);
+
+    return 0;
+}